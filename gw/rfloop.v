@@ -0,0 +1,619 @@
+/*
+ * rfloop.v
+ *
+ * RF loopback chain for one I/Q pair
+ *
+ * Delays the received I/Q samples, scales them and adds them to the
+ * samples coming from the DMA. Short delays use the BRAM delay line,
+ * long ones go through a ring buffer in DDR, followed by an optional
+ * fractional delay filter. The delayed signal can be frequency shifted
+ * (Doppler), faded (Rayleigh / Rician) and then goes through a N_TAPS
+ * multipath channel, the extra taps being up to 2^TAP_LOG - 1 samples
+ * after the main one, and white Gaussian noise of programmable power can
+ * be added. The output saturates and telemetry is available from the
+ * registers. A probe can replace the received signal by a known sequence
+ * and measure the round trip latency. A TDMA slot sequencer can switch
+ * the echo delay, scale and gate on each slot, to emulate several mobiles
+ * sharing a carrier. A ramp generator can move the delay continuously
+ * between two bounds, to emulate a mobile moving at constant speed.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module rfloop #(
+	parameter integer PAIR_ID = 0,
+	parameter integer N_TAPS  = 6,
+	parameter integer TAP_LOG = 8
+)(
+	// Datapath
+	input  wire data_valid,
+	input  wire [11:0] rx_data_i,
+	input  wire [11:0] rx_data_q,
+	input  wire [11:0] tx_data_i,
+	input  wire [11:0] tx_data_q,
+	output wire [11:0] dly_data_i,
+	output wire [11:0] dly_data_q,
+	output wire [11:0] out_data_i,
+	output wire [11:0] out_data_q,
+
+	// Long delay memory
+	output wire [31:0] m_axi_awaddr,
+	output wire [ 7:0] m_axi_awlen,
+	output wire [ 2:0] m_axi_awsize,
+	output wire [ 1:0] m_axi_awburst,
+	output wire [ 3:0] m_axi_awcache,
+	output wire [ 2:0] m_axi_awprot,
+	output wire        m_axi_awvalid,
+	input  wire        m_axi_awready,
+	output wire [63:0] m_axi_wdata,
+	output wire [ 7:0] m_axi_wstrb,
+	output wire        m_axi_wlast,
+	output wire        m_axi_wvalid,
+	input  wire        m_axi_wready,
+	input  wire [ 1:0] m_axi_bresp,
+	input  wire        m_axi_bvalid,
+	output wire        m_axi_bready,
+	output wire [31:0] m_axi_araddr,
+	output wire [ 7:0] m_axi_arlen,
+	output wire [ 2:0] m_axi_arsize,
+	output wire [ 1:0] m_axi_arburst,
+	output wire [ 3:0] m_axi_arcache,
+	output wire [ 2:0] m_axi_arprot,
+	output wire        m_axi_arvalid,
+	input  wire        m_axi_arready,
+	input  wire [63:0] m_axi_rdata,
+	input  wire [ 1:0] m_axi_rresp,
+	input  wire        m_axi_rlast,
+	input  wire        m_axi_rvalid,
+	output wire        m_axi_rready,
+
+	// Control
+	input  wire clk,
+	input  wire rst,
+
+	// Processor interface
+	input  wire        up_rstn,
+	input  wire        up_clk,
+	input  wire        up_wreq,
+	input  wire [13:0] up_waddr,
+	input  wire [31:0] up_wdata,
+	output wire        up_wack,
+	input  wire        up_rreq,
+	input  wire [13:0] up_raddr,
+	output wire [31:0] up_rdata,
+	output wire        up_rack
+);
+
+	// Signals
+	// -------
+
+	// Config
+	wire [31:0] cfg_ctrl;
+	wire [31:0] cfg_delay;
+	wire [15:0] cfg_delay_frac;
+	wire [15:0] cfg_scale;
+	wire [31:0] cfg_ddr_base;
+	wire [31:0] cfg_ddr_size;
+	wire [31:0] cfg_nco_freq;
+	wire [15:0] cfg_nco_phase;
+	wire [15:0] cfg_noise_level;
+	wire [23:0] cfg_fade_doppler;
+	wire [31:0] cfg_fade_gain;
+	wire [(N_TAPS-1)*16-1:0] cfg_tap_delay;
+	wire [(N_TAPS-1)*16-1:0] cfg_tap_scale;
+	wire [31:0] cfg_tdma_step;
+	wire [31:0] cfg_tdma_offset;
+	wire [8*32-1:0] cfg_slot_table;
+	wire [31:0] cfg_ramp_rate;
+	wire [31:0] cfg_ramp_bounds;
+	wire        cfg_load;
+	wire        cfg_long;
+	wire        cfg_nco;
+	wire        cfg_frac;
+	wire        cfg_fade;
+	wire        cfg_tdma;
+	wire        cfg_ramp;
+	wire        cfg_pingpong;
+	wire        cfg_probe_start;
+
+	// Status
+	wire stat_underflow;
+	wire stat_overflow;
+	wire [8*32-1:0] stat_regs;
+	wire stat_update;
+	wire [9:0] sat;
+	wire [1:0] frac_sat;
+	wire [1:0] rot_sat;
+	wire [1:0] fade_sat;
+	wire [1:0] chan_sat;
+	wire [1:0] noise_sat;
+
+	// Probe
+	wire [11:0] probe_data_i;
+	wire [11:0] probe_data_q;
+	wire probe_active;
+	wire [15:0] probe_lat;
+	wire [15:0] probe_peak;
+	wire probe_busy;
+	wire probe_done;
+	wire [11:0] in_data_i;
+	wire [11:0] in_data_q;
+
+	// Ramp
+	wire [15:0] ramp_delay;
+	wire [15:0] ramp_frac;
+	wire [31:0] base_delay;
+	wire [15:0] base_frac;
+
+	// TDMA
+	wire [2:0] tdma_slot;
+	wire [31:0] tdma_entry;
+	wire [31:0] echo_delay;
+	wire [15:0] echo_scale;
+	wire echo_gate;
+	reg  [16:0] echo_sv [0:13];
+	reg  [16:0] echo_sc [0:11];
+	wire [16:0] echo_line;
+	wire [16:0] echo_chan;
+	reg  [16:0] echo_wr;
+	reg  [16:0] echo_rd;
+	integer n;
+
+	// Delay
+	wire [31:0] line_delay;
+	wire [31:0] ddr_delay;
+	wire [11:0] bram_data_i;
+	wire [11:0] bram_data_q;
+	wire [23:0] ddr_data;
+
+	// Fractional delay
+	wire [11:0] frac_data_i;
+	wire [11:0] frac_data_q;
+	wire [11:0] fine_data_i;
+	wire [11:0] fine_data_q;
+
+	// Doppler
+	wire [11:0] rot_data_i;
+	wire [11:0] rot_data_q;
+	wire [11:0] dop_data_i;
+	wire [11:0] dop_data_q;
+
+	// Fading
+	wire [11:0] fade_data_i;
+	wire [11:0] fade_data_q;
+	wire [11:0] chan_data_i;
+	wire [11:0] chan_data_q;
+
+	// Multipath
+	wire [N_TAPS*TAP_LOG-1:0] tap_delay;
+	wire [N_TAPS*16-1:0] tap_scale;
+	wire [11:0] mp_data_i;
+	wire [11:0] mp_data_q;
+
+
+	// Registers
+	// ---------
+
+	up_rfloop #(
+		.PAIR_ID(PAIR_ID),
+		.N_TAPS(N_TAPS)
+	) regs_I (
+		.cfg_ctrl(cfg_ctrl),
+		.cfg_delay(cfg_delay),
+		.cfg_delay_frac(cfg_delay_frac),
+		.cfg_scale(cfg_scale),
+		.cfg_ddr_base(cfg_ddr_base),
+		.cfg_ddr_size(cfg_ddr_size),
+		.cfg_nco_freq(cfg_nco_freq),
+		.cfg_nco_phase(cfg_nco_phase),
+		.cfg_noise_level(cfg_noise_level),
+		.cfg_fade_doppler(cfg_fade_doppler),
+		.cfg_fade_gain(cfg_fade_gain),
+		.cfg_tap_delay(cfg_tap_delay),
+		.cfg_tap_scale(cfg_tap_scale),
+		.cfg_tdma_step(cfg_tdma_step),
+		.cfg_tdma_offset(cfg_tdma_offset),
+		.cfg_slot_table(cfg_slot_table),
+		.cfg_ramp_rate(cfg_ramp_rate),
+		.cfg_ramp_bounds(cfg_ramp_bounds),
+		.cfg_load(cfg_load),
+		.cfg_probe_start(cfg_probe_start),
+		.stat_flags({ stat_overflow, stat_underflow }),
+		.stat_regs(stat_regs),
+		.stat_update(stat_update),
+		.probe_flags({ probe_done, probe_busy }),
+		.probe_result({ probe_peak, probe_lat }),
+		.clk(clk),
+		.up_rstn(up_rstn),
+		.up_clk(up_clk),
+		.up_wreq(up_wreq),
+		.up_waddr(up_waddr),
+		.up_wdata(up_wdata),
+		.up_wack(up_wack),
+		.up_rreq(up_rreq),
+		.up_raddr(up_raddr),
+		.up_rdata(up_rdata),
+		.up_rack(up_rack)
+	);
+
+	assign cfg_long = cfg_ctrl[0];
+	assign cfg_nco  = cfg_ctrl[1];
+	assign cfg_frac = cfg_ctrl[2];
+	assign cfg_fade = cfg_ctrl[3];
+	assign cfg_tdma = cfg_ctrl[4];
+	assign cfg_ramp = cfg_ctrl[5];
+	assign cfg_pingpong = cfg_ctrl[6];
+
+
+	// Probe
+	// -----
+
+	sig_probe #(
+		.WIDTH(12),
+		.PN_LOG(6),
+		.CNT_W(16),
+		.AMP(1024)
+	) probe_I (
+		.data_valid(data_valid),
+		.rx_data_i(rx_data_i),
+		.rx_data_q(rx_data_q),
+		.probe_data_i(probe_data_i),
+		.probe_data_q(probe_data_q),
+		.probe_active(probe_active),
+		.start(cfg_probe_start),
+		.result_lat(probe_lat),
+		.result_peak(probe_peak),
+		.busy(probe_busy),
+		.done(probe_done),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// The sequence goes through the whole chain, like the received signal
+	assign in_data_i = probe_active ? probe_data_i : rx_data_i;
+	assign in_data_q = probe_active ? probe_data_q : rx_data_q;
+
+
+	// Ramp
+	// ----
+
+	// The fractional part lags by the BRAM delay line latency (4 valid
+	// samples, its delay input is registered on valid samples) and the
+	// Farrow history up to its interpolation point (2 more), so the whole
+	// delay moves smoothly across sample boundaries, whatever the
+	// data_valid pattern.
+	sig_ramp #(
+		.LAG(6)
+	) ramp_I (
+		.data_valid(data_valid),
+		.load(cfg_load),
+		.enable(cfg_ramp),
+		.pingpong(cfg_pingpong),
+		.start({ cfg_delay[15:0], cfg_delay_frac }),
+		.rate(cfg_ramp_rate),
+		.lo(cfg_ramp_bounds[15:0]),
+		.hi(cfg_ramp_bounds[31:16]),
+		.delay(ramp_delay),
+		.frac(ramp_frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	assign base_delay = cfg_ramp ? { 16'd0, ramp_delay } : cfg_delay;
+	assign base_frac  = cfg_ramp ? ramp_frac : cfg_delay_frac;
+
+
+	// TDMA
+	// ----
+
+	sig_tdma #(
+		.SLOT_LOG(3),
+		.E_WIDTH(32)
+	) tdma_I (
+		.data_valid(data_valid),
+		.step(cfg_tdma_step),
+		.offset(cfg_tdma_offset),
+		.slot_table(cfg_slot_table),
+		.slot(tdma_slot),
+		.slot_entry(tdma_entry),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// The slot entry replaces the echo scale and adds to its delay. The
+	// DDR delay line can't change delay without a reload, only the BRAM
+	// one follows the slots (and the ramp).
+	assign echo_delay = cfg_tdma ? (base_delay + { 17'd0, tdma_entry[30:16] }) : base_delay;
+	assign echo_scale = cfg_tdma ? tdma_entry[15:0] : cfg_scale;
+	assign echo_gate  = ~cfg_tdma | tdma_entry[31];
+
+	// The delay goes straight to the delay line, the scale and gate follow
+	// the samples down to the multipath so each output sample gets those
+	// of the slot its delay came from : the BRAM line (4 valid samples)
+	// and the fractional delay filter (10 more) advance with data_valid,
+	// the rotation (7 clock cycles) and fading (5) run freely.
+	always @(posedge clk)
+	begin
+		if (data_valid) begin
+			echo_sv[0] <= { echo_gate, echo_scale };
+			for (n=1; n<14; n=n+1)
+				echo_sv[n] <= echo_sv[n-1];
+		end
+	end
+
+	assign echo_line = cfg_frac ? echo_sv[13] : echo_sv[3];
+
+	always @(posedge clk)
+	begin
+		echo_sc[0] <= echo_line;
+		for (n=1; n<12; n=n+1)
+			echo_sc[n] <= echo_sc[n-1];
+	end
+
+	assign echo_chan =
+		(cfg_nco & cfg_fade) ? echo_sc[11] :
+		cfg_nco              ? echo_sc[6] :
+		cfg_fade             ? echo_sc[4] :
+		                       echo_line;
+
+	// The main tap reads the sample just written to the multipath window
+	always @(posedge clk)
+	begin
+		if (data_valid)
+			echo_wr <= echo_chan;
+		echo_rd <= echo_wr;
+	end
+
+
+	// Delay
+	// -----
+
+	// The fractional delay filter adds 10 samples (sig_farrow LATENCY, up
+	// to its output register, plus that register) taken out of the delay
+	// line so DELAY stays the total delay
+	assign line_delay = cfg_frac ? (echo_delay - 32'd10) : echo_delay;
+	assign ddr_delay  = cfg_frac ? (cfg_delay - 32'd10) : cfg_delay;
+
+	// Short : BRAM
+	sig_delay_iq #(
+		.WIDTH(12),
+		.DEPTH(32768)
+	) delay_bram_I (
+		.data_valid(data_valid),
+		.data_in_i(in_data_i),
+		.data_in_q(in_data_q),
+		.data_out_i(bram_data_i),
+		.data_out_q(bram_data_q),
+		.delay(line_delay[15:0]),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Long : DDR
+	sig_delay_ddr #(
+		.WIDTH(24),
+		.BURST_LOG(4),
+		.FIFO_LOG(6)
+	) delay_ddr_I (
+		.data_valid(data_valid & cfg_long),
+		.data_in({ in_data_q, in_data_i }),
+		.data_out(ddr_data),
+		.delay(ddr_delay),
+		.mem_base(cfg_ddr_base),
+		.mem_size(cfg_ddr_size),
+		.load(cfg_load),
+		.underflow(stat_underflow),
+		.overflow(stat_overflow),
+		.m_axi_awaddr(m_axi_awaddr),
+		.m_axi_awlen(m_axi_awlen),
+		.m_axi_awsize(m_axi_awsize),
+		.m_axi_awburst(m_axi_awburst),
+		.m_axi_awcache(m_axi_awcache),
+		.m_axi_awprot(m_axi_awprot),
+		.m_axi_awvalid(m_axi_awvalid),
+		.m_axi_awready(m_axi_awready),
+		.m_axi_wdata(m_axi_wdata),
+		.m_axi_wstrb(m_axi_wstrb),
+		.m_axi_wlast(m_axi_wlast),
+		.m_axi_wvalid(m_axi_wvalid),
+		.m_axi_wready(m_axi_wready),
+		.m_axi_bresp(m_axi_bresp),
+		.m_axi_bvalid(m_axi_bvalid),
+		.m_axi_bready(m_axi_bready),
+		.m_axi_araddr(m_axi_araddr),
+		.m_axi_arlen(m_axi_arlen),
+		.m_axi_arsize(m_axi_arsize),
+		.m_axi_arburst(m_axi_arburst),
+		.m_axi_arcache(m_axi_arcache),
+		.m_axi_arprot(m_axi_arprot),
+		.m_axi_arvalid(m_axi_arvalid),
+		.m_axi_arready(m_axi_arready),
+		.m_axi_rdata(m_axi_rdata),
+		.m_axi_rresp(m_axi_rresp),
+		.m_axi_rlast(m_axi_rlast),
+		.m_axi_rvalid(m_axi_rvalid),
+		.m_axi_rready(m_axi_rready),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	assign dly_data_i = cfg_long ? ddr_data[11: 0] : bram_data_i;
+	assign dly_data_q = cfg_long ? ddr_data[23:12] : bram_data_q;
+
+
+	// Fractional delay
+	// ----------------
+
+	sig_farrow #(
+		.WIDTH(12)
+	) farrow_i_I (
+		.data_valid(data_valid),
+		.data_in(dly_data_i),
+		.data_out(frac_data_i),
+		.data_sat(frac_sat[0]),
+		.frac(base_frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_farrow #(
+		.WIDTH(12)
+	) farrow_q_I (
+		.data_valid(data_valid),
+		.data_in(dly_data_q),
+		.data_out(frac_data_q),
+		.data_sat(frac_sat[1]),
+		.frac(base_frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	assign fine_data_i = cfg_frac ? frac_data_i : dly_data_i;
+	assign fine_data_q = cfg_frac ? frac_data_q : dly_data_q;
+
+
+	// Doppler
+	// -------
+
+	sig_rotate #(
+		.D_WIDTH(12),
+		.PHASE_LOG(10)
+	) rotate_I (
+		.data_valid(data_valid),
+		.in_data_i(fine_data_i),
+		.in_data_q(fine_data_q),
+		.out_data_i(rot_data_i),
+		.out_data_q(rot_data_q),
+		.out_sat(rot_sat),
+		.freq(cfg_nco_freq),
+		.phase(cfg_nco_phase),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	assign dop_data_i = cfg_nco ? rot_data_i : fine_data_i;
+	assign dop_data_q = cfg_nco ? rot_data_q : fine_data_q;
+
+
+	// Fading
+	// ------
+
+	sig_fading #(
+		.D_WIDTH(12),
+		.M_LOG(4),
+		.PHASE_LOG(10),
+		.SEED(PAIR_ID ? 32'h510e527f : 32'h00000000)
+	) fading_I (
+		.data_valid(data_valid),
+		.in_data_i(dop_data_i),
+		.in_data_q(dop_data_q),
+		.out_data_i(fade_data_i),
+		.out_data_q(fade_data_q),
+		.out_sat(fade_sat),
+		.doppler(cfg_fade_doppler),
+		.los(cfg_fade_gain[15:0]),
+		.diffuse(cfg_fade_gain[31:16]),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	assign chan_data_i = cfg_fade ? fade_data_i : dop_data_i;
+	assign chan_data_q = cfg_fade ? fade_data_q : dop_data_q;
+
+
+	// Multipath
+	// ---------
+
+	// Tap 0 is the main path. The gate goes along with the samples in the
+	// multipath window, so the taps of an echo are muted with it.
+	assign tap_delay[TAP_LOG-1:0] = 0;
+	assign tap_scale[15:0] = echo_rd[15:0];
+
+	genvar k;
+
+	generate
+		for (k=1; k<N_TAPS; k=k+1)
+		begin
+			assign tap_delay[TAP_LOG*k+:TAP_LOG] = cfg_tap_delay[16*(k-1)+:TAP_LOG];
+			assign tap_scale[16*k+:16] = cfg_tap_scale[16*(k-1)+:16];
+		end
+	endgenerate
+
+	sig_multipath #(
+		.N_TAPS(N_TAPS),
+		.TAP_LOG(TAP_LOG),
+		.D_WIDTH(12),
+		.S_WIDTH(16),
+		.S_FRAC(14)
+	) multipath_I (
+		.data_valid(data_valid),
+		.in_data_i(chan_data_i),
+		.in_data_q(chan_data_q),
+		.in_gate(echo_chan[16]),
+		.in_chain_i(tx_data_i),
+		.in_chain_q(tx_data_q),
+		.out_data_i(mp_data_i),
+		.out_data_q(mp_data_q),
+		.out_sat(chan_sat),
+		.tap_delay(tap_delay),
+		.tap_scale(tap_scale),
+		.clk(clk),
+		.rst(rst)
+	);
+
+
+	// Noise
+	// -----
+
+	sig_noise #(
+		.WIDTH(12),
+		.SEED_I(PAIR_ID ? 64'h6a09e667f3bcc908 : 64'h2545f4914f6cdd1d),
+		.SEED_Q(PAIR_ID ? 64'hbb67ae8584caa73b : 64'h9e3779b97f4a7c15)
+	) noise_I (
+		.data_valid(data_valid),
+		.in_data_i(mp_data_i),
+		.in_data_q(mp_data_q),
+		.out_data_i(out_data_i),
+		.out_data_q(out_data_q),
+		.out_sat(noise_sat),
+		.level(cfg_noise_level),
+		.clk(clk),
+		.rst(rst)
+	);
+
+
+	// Telemetry
+	// ---------
+
+	assign sat = {
+		noise_sat,
+		chan_sat,
+		fade_sat & { 2{cfg_fade} },
+		rot_sat  & { 2{cfg_nco} },
+		frac_sat & { 2{cfg_frac} }
+	};
+
+	sig_stats #(
+		.WIDTH(12),
+		.N_SAT(10),
+		.WIN_LOG(20)
+	) stats_I (
+		.data_valid(data_valid),
+		.rx_data_i(rx_data_i),
+		.rx_data_q(rx_data_q),
+		.tx_data_i(out_data_i),
+		.tx_data_q(out_data_q),
+		.sat(sat),
+		.stat_regs(stat_regs),
+		.stat_update(stat_update),
+		.clk(clk),
+		.rst(rst)
+	);
+
+endmodule // rfloop
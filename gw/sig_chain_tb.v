@@ -11,27 +11,42 @@
 
 module sig_chain_tb;
 
+	// Valid samples not checked directly after a delay change
+	localparam integer SETTLE = 4;
+
 	// Signals
 	reg rst = 1;
 	reg clk = 0;
 
 	reg  data_valid;
-	reg  [11:0] data_in;
+	reg  data_hold = 1'b0;
+	reg  [23:0] data_idx;
+	wire [11:0] data_in;
+	wire [11:0] data_in_q;
 	wire [11:0] data_out;
+	wire [11:0] data_out_q;
 	wire [11:0] data_comb_3;
-	wire [14:0] cfg_delay;
+	reg  [15:0] cfg_delay;
+
+	wire [11:0] iq_out_i;
+	wire [11:0] iq_out_q;
+
+	reg  chk;
+	reg  chk_ena = 0;
+	reg  chk_ref = 1;
+	integer settle = 0;
+	wire [23:0] exp_idx;
+	wire [11:0] exp_i;
+	wire [11:0] exp_q;
+	integer errors = 0;
 
 	// Setup recording
+`ifdef DUMP
 	initial begin
 		$dumpfile("sig_chain_tb.vcd");
 		$dumpvars(0,sig_chain_tb);
 	end
-
-	// Reset pulse
-	initial begin
-		# 21 rst = 0;
-		# 50000 $finish;
-	end
+`endif
 
 	// Clock
 	always #5 clk = !clk;
@@ -43,7 +58,18 @@ module sig_chain_tb;
 		.data_valid(data_valid),
 		.data_in(data_in),
 		.data_out(data_out),
-		.delay(cfg_delay),
+		.delay(cfg_delay[14:0]),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_delay #(
+		.WIDTH(12)
+	) dut_A_Q (
+		.data_valid(data_valid),
+		.data_in(data_in_q),
+		.data_out(data_out_q),
+		.delay(cfg_delay[14:0]),
 		.clk(clk),
 		.rst(rst)
 	);
@@ -56,25 +82,141 @@ module sig_chain_tb;
 		.in_data_0(data_out),
 		.in_scale_0(16'h2000),	// 0.5
 		.in_chain_0(data_in),
+		.in_pcin_2(48'h000000000000),
 		.out_3(data_comb_3),
+		.out_sat_3(),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_delay_iq #(
+		.WIDTH(12),
+		.DEPTH(32768)
+	) dut_C_I (
+		.data_valid(data_valid),
+		.data_in_i(data_in),
+		.data_in_q(data_in_q),
+		.data_out_i(iq_out_i),
+		.data_out_q(iq_out_q),
+		.delay(cfg_delay),
 		.clk(clk),
 		.rst(rst)
 	);
 
-	// Data gen
+	// Data gen : I/Q made from the index of the sample, unique over the
+	// whole ring so a read from the wrong lap or lane can't go unnoticed
 	always @(posedge clk)
 		if (rst)
-			data_in <= 0;
+			data_idx <= 0;
 		else if (data_valid)
-			data_in <= data_in + 1;
+			data_idx <= data_idx + 1;
+
+	assign data_in   = data_idx[11:0];
+	assign data_in_q = data_idx[23:12] ^ data_idx[11:0] ^ 12'ha5a;
 
 	always @(posedge clk)
-		if (rst)
+		if (rst | data_hold)
 			data_valid <= 1'b0;
 		else
 			data_valid <= ($random & 3) == 0;
 
-	// Config
-	assign cfg_delay = 14'h00;
+	// Checkers, once the delay change made it through (the packed line
+	// takes one valid sample more than the per-bit one)
+	always @(posedge clk)
+		chk <= data_valid;
+
+	// Output for the n-th valid sample is input sample n - delay - 2,
+	// data_idx being n + 1 by now
+	assign exp_idx = data_idx - { 8'd0, cfg_delay } - 24'd3;
+	assign exp_i   = exp_idx[11:0];
+	assign exp_q   = exp_idx[23:12] ^ exp_idx[11:0] ^ 12'ha5a;
+
+	always @(negedge clk)
+	begin
+		if (chk & (settle > 0))
+			settle = settle - 1;
+		else if (chk_ena & (settle == 0)) begin
+			// Packed I/Q line must match the per-bit one cycle by cycle,
+			// for the delays it supports
+			if (chk_ref & ((iq_out_i !== data_out) || (iq_out_q !== data_out_q))) begin
+				if (errors < 10)
+					$display("[!] Delay %0d : got %03x/%03x, expected %03x/%03x",
+						cfg_delay, iq_out_i, iq_out_q, data_out, data_out_q);
+				errors = errors + 1;
+			end
+
+			if (chk && (data_idx >= cfg_delay + 8) &&
+			    ((iq_out_i !== exp_i) || (iq_out_q !== exp_q))) begin
+				if (errors < 10)
+					$display("[!] Delay %0d : got %03x/%03x, expected sample %0d (%03x/%03x)",
+						cfg_delay, iq_out_i, iq_out_q, exp_idx, exp_i, exp_q);
+				errors = errors + 1;
+			end
+		end
+	end
+
+	// Scenario
+	task run;
+		input [15:0] delay;
+		input integer samples;
+		integer n;
+		begin
+			// Only change the delay while no samples are flowing
+			@(negedge clk);
+			data_hold = 1'b1;
+			repeat (4) @(negedge clk);
+			cfg_delay = delay;
+			chk_ref = (delay < 32768);
+			settle = SETTLE;
+			repeat (4) @(negedge clk);
+			data_hold = 1'b0;
+
+			n = 0;
+			while (n < samples) begin
+				@(negedge clk);
+				if (chk)
+					n = n + 1;
+			end
+		end
+	endtask
+
+	initial begin
+		cfg_delay = 0;
+		# 21 rst = 0;
+
+		// Skip the first samples, the reference reads back what it's
+		// writing in the same cycle
+		wait (data_in == 4);
+		chk_ena = 1;
+
+		run(    0,  1000);
+		run(    1,  1000);
+		run(    2,  1000);
+		run(    3,  1000);
+		run(    4,  1000);
+		run(    5,  1000);
+		run(    7,  1000);
+		run(  100,  1000);
+		run( 1535,  2000);
+		run( 1536,  2000);
+		run(    2,  1000);
+		run(20000, 21000);
+		run(32766, 40000);
+
+		// Longest delays, only reachable thanks to the samples stored in
+		// the parity bits : checked against the sample index alone
+		run(33789,  4000);
+		run(33790,  4000);
+		run(    1,  1000);
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_chain_tb: PASS");
+		else
+			$display("[!] sig_chain_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
 
 endmodule // sig_chain_tb
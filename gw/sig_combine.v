@@ -3,6 +3,13 @@
  *
  * Simple signal combiner using DSP48E
  *
+ * With CHAIN_INPUT = "CASCADE", the chained value comes from the previous
+ * combiner P output through PCIN instead of `in_chain_0`. That input is
+ * one cycle ahead of `in_chain_0` : a cascade of combiners must have the
+ * `in_data_0` of stage k delayed by k cycles (systolic sum).
+ *
+ * `out_3` saturates, `out_sat_3` flags when it does.
+ *
  * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
  *
  * vim: ts=4 sw=4
@@ -15,15 +22,19 @@
 module sig_combine #(
 	parameter integer D_WIDTH = 12,
 	parameter integer S_WIDTH = 16,
-	parameter integer S_FRAC  = 14
+	parameter integer S_FRAC  = 14,
+	parameter CHAIN_INPUT = "DIRECT"	// "DIRECT" or "CASCADE"
 )(
 	// Input
 	input  wire [D_WIDTH-1:0] in_data_0,
 	input  wire [S_WIDTH-1:0] in_scale_0,
 	input  wire [D_WIDTH-1:0] in_chain_0,
+	input  wire [47:0] in_pcin_2,
 
 	// Output
 	output wire [D_WIDTH-1:0] out_3,
+	output wire out_sat_3,
+	output wire [47:0] out_pcout_3,
 
 	// Control
 	input  wire clk,
@@ -31,13 +42,21 @@ module sig_combine #(
 );
 	localparam S = 25 - D_WIDTH + S_FRAC;
 
+	// String parameter against literals of other lengths
+	/* verilator lint_off WIDTH */
+	localparam [6:0] OPMODE = (CHAIN_INPUT == "CASCADE") ?
+		7'b0010101 :	// X=M1, Y=M2, Z=PCIN
+		7'b0110101;		// X=M1, Y=M2, Z=C
+	/* verilator lint_on WIDTH */
+
 	// Signals
-	reg  [17:0] in_chain_1;
+	reg  [D_WIDTH-1:0] in_chain_1;
 
 	wire [47:0] pout_3;
 	wire [29:0] a_0;
 	wire [17:0] b_0;
 	wire [47:0] c_1;
+	wire [47-S-D_WIDTH+1:0] pout_top_3;
 
 	// Align C
 	always @(posedge clk)
@@ -45,10 +64,16 @@ module sig_combine #(
 
 	// Map in/out
 	assign a_0 = { 5'd0, in_data_0,  { (25-D_WIDTH){1'b0} } };
-	assign b_0 = { { (18-S_WIDTH){1'b0} }, in_scale_0 };
+	assign b_0 = { { (18-S_WIDTH){in_scale_0[S_WIDTH-1]} }, in_scale_0 };
 	assign c_1 = { { (48-S-D_WIDTH){in_chain_1[D_WIDTH-1]} }, in_chain_1, { (S){1'b0} } };
 
-	assign out_3 = pout_3[S+:D_WIDTH];
+	// Saturate when the bits above the output aren't all sign bits
+	assign pout_top_3 = pout_3[47:S+D_WIDTH-1];
+	assign out_sat_3  = (|pout_top_3) & ~(&pout_top_3);
+
+	assign out_3 = out_sat_3 ?
+		{ pout_3[47], { (D_WIDTH-1){~pout_3[47]} } } :
+		pout_3[S+:D_WIDTH];
 
 	// DSP
 	DSP48E1 #(
@@ -83,13 +108,14 @@ module sig_combine #(
 		.BCIN(18'h0),
 		.CARRYCASCIN(1'h0),
 		.MULTSIGNIN(1'h0),
-		.PCIN(48'h000000000000),
+		.PCIN(in_pcin_2),
+		.PCOUT(out_pcout_3),
 		.ALUMODE(4'b0000),      // Z + X + Y + CIN
 		.CARRYINSEL(3'h0),
 		.CEINMODE(1'b1),
 		.CLK(clk),
 		.INMODE(5'b00000),      // B=B2, A=A2
-		.OPMODE(7'b0110101),    // X=M1, Y=M2, Z=C
+		.OPMODE(OPMODE),
 		.RSTINMODE(rst),
 		.A(a_0),
 		.B(b_0),
@@ -0,0 +1,418 @@
+/*
+ * sig_delay_ddr.v
+ *
+ * Signal delay line - long delays through a ring buffer in external memory
+ *
+ * The samples are streamed to a ring buffer in DDR through an AXI master
+ * and read back 'delay' samples later. Each 64 bits memory word holds
+ * two samples and all accesses are aligned bursts of BEATS words.
+ *
+ * To match `sig_delay`, the output for the n-th valid sample is input
+ * sample n - delay - 2 (and zero before that).
+ *
+ * Changing the configuration requires a `load` pulse, which waits for
+ * in-flight bursts to complete and then restarts the ring. The minimum
+ * usable delay is a bit over one burst worth of samples plus the memory
+ * round trip, anything shorter underflows (use `sig_delay` for those).
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_delay_ddr #(
+	parameter integer WIDTH = 24,		// Must be < 32
+	parameter integer BURST_LOG = 4,
+	parameter integer FIFO_LOG = 6
+)(
+	// Data
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] data_in,
+	output reg  [WIDTH-1:0] data_out,
+
+	// Config
+	input  wire [31:0] delay,		// In samples
+	input  wire [31:0] mem_base,	// Byte address, burst aligned
+	input  wire [31:0] mem_size,	// Bytes, power of two
+	input  wire load,
+
+	// Status (sticky until next load)
+	output reg  underflow,
+	output reg  overflow,
+
+	// AXI master - Write
+	output wire [31:0] m_axi_awaddr,
+	output wire [ 7:0] m_axi_awlen,
+	output wire [ 2:0] m_axi_awsize,
+	output wire [ 1:0] m_axi_awburst,
+	output wire [ 3:0] m_axi_awcache,
+	output wire [ 2:0] m_axi_awprot,
+	output wire        m_axi_awvalid,
+	input  wire        m_axi_awready,
+	output wire [63:0] m_axi_wdata,
+	output wire [ 7:0] m_axi_wstrb,
+	output wire        m_axi_wlast,
+	output wire        m_axi_wvalid,
+	input  wire        m_axi_wready,
+	input  wire [ 1:0] m_axi_bresp,
+	input  wire        m_axi_bvalid,
+	output wire        m_axi_bready,
+
+	// AXI master - Read
+	output wire [31:0] m_axi_araddr,
+	output wire [ 7:0] m_axi_arlen,
+	output wire [ 2:0] m_axi_arsize,
+	output wire [ 1:0] m_axi_arburst,
+	output wire [ 3:0] m_axi_arcache,
+	output wire [ 2:0] m_axi_arprot,
+	output wire        m_axi_arvalid,
+	input  wire        m_axi_arready,
+	input  wire [63:0] m_axi_rdata,
+	input  wire [ 1:0] m_axi_rresp,
+	input  wire        m_axi_rlast,
+	input  wire        m_axi_rvalid,
+	output wire        m_axi_rready,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer BEATS = 1 << BURST_LOG;
+	localparam integer FIFO_DEPTH = 1 << FIFO_LOG;
+
+	localparam [1:0] ST_IDLE = 2'd0,
+	                 ST_ADDR = 2'd1,
+	                 ST_DATA = 2'd2,
+	                 ST_RESP = 2'd3;
+
+	// Signals
+	// -------
+
+	// Restart
+	reg  restart;
+	wire srst;
+
+	// Ring
+	wire [31:0] ring_mask;
+	wire [31:0] ring_beats;
+
+	// Input packing
+	wire [31:0] in_sample;
+	reg  [31:0] in_lo;
+	reg  in_odd;
+	wire in_beat;
+	wire in_drop;
+	reg  [15:0] wr_debt;
+
+	// Write FIFO
+	wire [63:0] wf_wr_data;
+	wire wf_wr_ena;
+	wire wf_full;
+	wire [63:0] wf_rd_data;
+	wire wf_rd_ena;
+	wire [FIFO_LOG:0] wf_level;
+
+	// Write engine
+	reg  [1:0] ws;
+	reg  [BURST_LOG-1:0] ws_cnt;
+	reg  [31:0] wr_beat;
+	reg  [31:0] wr_addr;
+	wire wr_start;
+
+	// Read engine
+	reg  [1:0] rs;
+	reg  [31:0] rd_beat;
+	reg  [31:0] rd_addr;
+	wire rd_start;
+
+	// Read FIFO
+	wire rf_wr_ena;
+	wire [63:0] rf_rd_data;
+	wire rf_rd_ena;
+	wire rf_empty;
+	wire [FIFO_LOG:0] rf_level;
+
+	// Output
+	reg  [31:0] pre_cnt;
+	reg  live;
+	reg  out_odd;
+	reg  [15:0] rd_debt;
+	wire [31:0] out_sample;
+	wire out_want;
+	wire out_take;
+	wire out_skip;
+
+
+	// Restart
+	// -------
+
+	// Bursts can't be aborted, so wait for both engines to be idle
+	always @(posedge clk)
+	begin
+		if (rst)
+			restart <= 1'b0;
+		else if (load)
+			restart <= 1'b1;
+		else if (srst)
+			restart <= 1'b0;
+	end
+
+	assign srst = rst | (restart & (ws == ST_IDLE) & (rs == ST_IDLE));
+
+	assign ring_mask  = mem_size - 1;
+	assign ring_beats = { 3'b000, mem_size[31:3] };
+
+
+	// Input
+	// -----
+
+	assign in_sample = { {(32-WIDTH){1'b0}}, data_in };
+
+	always @(posedge clk)
+	begin
+		if (srst)
+			in_odd <= 1'b0;
+		else if (data_valid)
+			in_odd <= ~in_odd;
+	end
+
+	always @(posedge clk)
+		if (data_valid & ~in_odd)
+			in_lo <= in_sample;
+
+	// Beats lost to a full FIFO are replaced by zeros to keep the
+	// stream aligned with the requested delay
+	assign in_beat = data_valid & in_odd;
+	assign in_drop = in_beat & wf_full;
+
+	assign wf_wr_ena  = ~wf_full & (in_beat | (wr_debt != 0));
+	assign wf_wr_data = in_beat ? { in_sample, in_lo } : 64'd0;
+
+	always @(posedge clk)
+	begin
+		if (srst)
+			wr_debt <= 0;
+		else if (in_drop)
+			wr_debt <= wr_debt + 1;
+		else if (wf_wr_ena & ~in_beat)
+			wr_debt <= wr_debt - 1;
+	end
+
+	sig_fifo #(
+		.WIDTH(64),
+		.AWIDTH(FIFO_LOG)
+	) wr_fifo_I (
+		.wr_data(wf_wr_data),
+		.wr_ena(wf_wr_ena),
+		.full(wf_full),
+		.rd_data(wf_rd_data),
+		.rd_ena(wf_rd_ena),
+		.empty(),
+		.level(wf_level),
+		.clk(clk),
+		.rst(srst)
+	);
+
+
+	// Write engine
+	// ------------
+
+	// Only start when a full burst is buffered and it won't overwrite
+	// anything that wasn't read back yet
+	assign wr_start = (ws == ST_IDLE) & ~restart &
+		(wf_level >= BEATS) &
+		((wr_beat - rd_beat) <= (ring_beats - BEATS));
+
+	always @(posedge clk)
+	begin
+		if (srst) begin
+			ws      <= ST_IDLE;
+			ws_cnt  <= 0;
+			wr_beat <= 0;
+		end else begin
+			case (ws)
+				ST_IDLE:
+					if (wr_start)
+						ws <= ST_ADDR;
+
+				ST_ADDR:
+					if (m_axi_awready)
+						ws <= ST_DATA;
+
+				ST_DATA:
+					if (m_axi_wready) begin
+						ws_cnt <= ws_cnt + 1;
+						if (ws_cnt == (BEATS-1))
+							ws <= ST_RESP;
+					end
+
+				ST_RESP:
+					if (m_axi_bvalid) begin
+						ws <= ST_IDLE;
+						wr_beat <= wr_beat + BEATS;
+					end
+			endcase
+		end
+	end
+
+	always @(posedge clk)
+		wr_addr <= mem_base + ({ wr_beat[28:0], 3'b000 } & ring_mask);
+
+	assign m_axi_awaddr  = wr_addr;
+	assign m_axi_awlen   = BEATS - 1;
+	assign m_axi_awsize  = 3'b011;		// 8 bytes
+	assign m_axi_awburst = 2'b01;		// INCR
+	assign m_axi_awcache = 4'b0011;
+	assign m_axi_awprot  = 3'b000;
+	assign m_axi_awvalid = (ws == ST_ADDR);
+
+	assign m_axi_wdata  = wf_rd_data;
+	assign m_axi_wstrb  = 8'hff;
+	assign m_axi_wlast  = (ws_cnt == (BEATS-1));
+	assign m_axi_wvalid = (ws == ST_DATA);
+
+	assign m_axi_bready = (ws == ST_RESP);
+
+	assign wf_rd_ena = m_axi_wvalid & m_axi_wready;
+
+
+	// Read engine
+	// -----------
+
+	// Only fetch data that was committed to memory and that fits
+	assign rd_start = (rs == ST_IDLE) & ~restart &
+		((wr_beat - rd_beat) >= BEATS) &
+		(rf_level <= (FIFO_DEPTH - BEATS));
+
+	always @(posedge clk)
+	begin
+		if (srst) begin
+			rs      <= ST_IDLE;
+			rd_beat <= 0;
+		end else begin
+			case (rs)
+				ST_IDLE:
+					if (rd_start)
+						rs <= ST_ADDR;
+
+				ST_ADDR:
+					if (m_axi_arready)
+						rs <= ST_DATA;
+
+				ST_DATA:
+					if (m_axi_rvalid & m_axi_rlast) begin
+						rs <= ST_IDLE;
+						rd_beat <= rd_beat + BEATS;
+					end
+
+				default:
+					rs <= ST_IDLE;
+			endcase
+		end
+	end
+
+	always @(posedge clk)
+		rd_addr <= mem_base + ({ rd_beat[28:0], 3'b000 } & ring_mask);
+
+	assign m_axi_araddr  = rd_addr;
+	assign m_axi_arlen   = BEATS - 1;
+	assign m_axi_arsize  = 3'b011;		// 8 bytes
+	assign m_axi_arburst = 2'b01;		// INCR
+	assign m_axi_arcache = 4'b0011;
+	assign m_axi_arprot  = 3'b000;
+	assign m_axi_arvalid = (rs == ST_ADDR);
+
+	assign m_axi_rready = (rs == ST_DATA);
+
+	assign rf_wr_ena = m_axi_rvalid & m_axi_rready;
+
+	sig_fifo #(
+		.WIDTH(64),
+		.AWIDTH(FIFO_LOG)
+	) rd_fifo_I (
+		.wr_data(m_axi_rdata),
+		.wr_ena(rf_wr_ena),
+		.full(),
+		.rd_data(rf_rd_data),
+		.rd_ena(rf_rd_ena),
+		.empty(rf_empty),
+		.level(rf_level),
+		.clk(clk),
+		.rst(srst)
+	);
+
+
+	// Output
+	// ------
+
+	// Output zeros until the first sample is due
+	always @(posedge clk)
+	begin
+		if (srst) begin
+			pre_cnt <= 0;
+			live <= 1'b0;
+		end else if (data_valid & ~live) begin
+			pre_cnt <= pre_cnt + 1;
+			live <= (pre_cnt == (delay + 1));
+		end
+	end
+
+	// Samples missed because of underflow are dropped as soon as they
+	// show up to keep the delay constant
+	assign out_want = data_valid & live;
+	assign out_take = out_want & ~rf_empty;
+	assign out_skip = ~data_valid & (rd_debt != 0) & ~rf_empty;
+
+	assign out_sample = out_odd ? rf_rd_data[63:32] : rf_rd_data[31:0];
+
+	assign rf_rd_ena = (out_take | out_skip) & out_odd;
+
+	always @(posedge clk)
+	begin
+		if (srst)
+			out_odd <= 1'b0;
+		else if (out_take | out_skip)
+			out_odd <= ~out_odd;
+	end
+
+	always @(posedge clk)
+	begin
+		if (srst)
+			rd_debt <= 0;
+		else if (out_want & rf_empty)
+			rd_debt <= rd_debt + 1;
+		else if (out_skip)
+			rd_debt <= rd_debt - 1;
+	end
+
+	always @(posedge clk)
+	begin
+		if (srst)
+			data_out <= 0;
+		else if (data_valid)
+			data_out <= out_take ? out_sample[WIDTH-1:0] : { WIDTH{1'b0} };
+	end
+
+
+	// Status
+	// ------
+
+	always @(posedge clk)
+	begin
+		if (srst) begin
+			underflow <= 1'b0;
+			overflow  <= 1'b0;
+		end else begin
+			if (out_want & rf_empty)
+				underflow <= 1'b1;
+			if (in_drop)
+				overflow <= 1'b1;
+		end
+	end
+
+endmodule // sig_delay_ddr
@@ -0,0 +1,246 @@
+/*
+ * sig_delay_ddr_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_delay_ddr_tb;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  [23:0] data_in;
+	wire [23:0] data_out;
+
+	reg  [31:0] cfg_delay;
+	reg  cfg_load = 0;
+
+	wire stat_underflow;
+	wire stat_overflow;
+
+	wire [31:0] axi_awaddr;
+	wire [ 7:0] axi_awlen;
+	wire        axi_awvalid;
+	wire        axi_awready;
+	wire [63:0] axi_wdata;
+	wire [ 7:0] axi_wstrb;
+	wire        axi_wlast;
+	wire        axi_wvalid;
+	wire        axi_wready;
+	wire [ 1:0] axi_bresp;
+	wire        axi_bvalid;
+	wire        axi_bready;
+	wire [31:0] axi_araddr;
+	wire [ 7:0] axi_arlen;
+	wire        axi_arvalid;
+	wire        axi_arready;
+	wire [63:0] axi_rdata;
+	wire [ 1:0] axi_rresp;
+	wire        axi_rlast;
+	wire        axi_rvalid;
+	wire        axi_rready;
+
+	reg  chk;
+	reg  chk_ena = 0;
+	reg  [23:0] chk_n;
+	reg  [31:0] chk_exp;
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_delay_ddr_tb.vcd");
+		$dumpvars(0,sig_delay_ddr_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_delay_ddr #(
+		.WIDTH(24),
+		.BURST_LOG(4),
+		.FIFO_LOG(6)
+	) dut_I (
+		.data_valid(data_valid),
+		.data_in(data_in),
+		.data_out(data_out),
+		.delay(cfg_delay),
+		.mem_base(32'h00001000),
+		.mem_size(32'h00004000),		// 4096 samples ring
+		.load(cfg_load),
+		.underflow(stat_underflow),
+		.overflow(stat_overflow),
+		.m_axi_awaddr(axi_awaddr),
+		.m_axi_awlen(axi_awlen),
+		.m_axi_awsize(),
+		.m_axi_awburst(),
+		.m_axi_awcache(),
+		.m_axi_awprot(),
+		.m_axi_awvalid(axi_awvalid),
+		.m_axi_awready(axi_awready),
+		.m_axi_wdata(axi_wdata),
+		.m_axi_wstrb(axi_wstrb),
+		.m_axi_wlast(axi_wlast),
+		.m_axi_wvalid(axi_wvalid),
+		.m_axi_wready(axi_wready),
+		.m_axi_bresp(axi_bresp),
+		.m_axi_bvalid(axi_bvalid),
+		.m_axi_bready(axi_bready),
+		.m_axi_araddr(axi_araddr),
+		.m_axi_arlen(axi_arlen),
+		.m_axi_arsize(),
+		.m_axi_arburst(),
+		.m_axi_arcache(),
+		.m_axi_arprot(),
+		.m_axi_arvalid(axi_arvalid),
+		.m_axi_arready(axi_arready),
+		.m_axi_rdata(axi_rdata),
+		.m_axi_rresp(axi_rresp),
+		.m_axi_rlast(axi_rlast),
+		.m_axi_rvalid(axi_rvalid),
+		.m_axi_rready(axi_rready),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Memory model
+	sim_axi_mem #(
+		.AWIDTH(15),
+		.LATENCY(16)
+	) mem_I (
+		.s_axi_awaddr(axi_awaddr),
+		.s_axi_awlen(axi_awlen),
+		.s_axi_awvalid(axi_awvalid),
+		.s_axi_awready(axi_awready),
+		.s_axi_wdata(axi_wdata),
+		.s_axi_wstrb(axi_wstrb),
+		.s_axi_wlast(axi_wlast),
+		.s_axi_wvalid(axi_wvalid),
+		.s_axi_wready(axi_wready),
+		.s_axi_bresp(axi_bresp),
+		.s_axi_bvalid(axi_bvalid),
+		.s_axi_bready(axi_bready),
+		.s_axi_araddr(axi_araddr),
+		.s_axi_arlen(axi_arlen),
+		.s_axi_arvalid(axi_arvalid),
+		.s_axi_arready(axi_arready),
+		.s_axi_rdata(axi_rdata),
+		.s_axi_rresp(axi_rresp),
+		.s_axi_rlast(axi_rlast),
+		.s_axi_rvalid(axi_rvalid),
+		.s_axi_rready(axi_rready),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Data gen : sample index since the last (re)start of the ring
+	always @(posedge clk)
+		if (dut_I.srst)
+			data_in <= 0;
+		else if (data_valid)
+			data_in <= data_in + 1;
+
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ($random & 3) == 0;
+
+	// Checker
+	always @(posedge clk)
+	begin
+		chk   <= data_valid & ~dut_I.srst;
+		chk_n <= data_in;
+	end
+
+	always @(negedge clk)
+	begin
+		if (chk & chk_ena) begin
+			chk_exp = (chk_n >= (cfg_delay + 2)) ? (chk_n - cfg_delay - 2) : 0;
+			if (data_out !== chk_exp[23:0]) begin
+				if (errors < 10)
+					$display("[!] Sample %0d : got %0d, expected %0d", chk_n, data_out, chk_exp[23:0]);
+				errors = errors + 1;
+			end
+		end
+	end
+
+	// Scenario
+	task restart;
+		input [31:0] delay;
+		reg ena;
+		begin
+			// Output isn't predictable until the ring restarted
+			ena = chk_ena;
+			chk_ena = 0;
+			@(negedge clk);
+			cfg_delay = delay;
+			cfg_load  = 1'b1;
+			@(negedge clk);
+			cfg_load  = 1'b0;
+			wait (dut_I.srst == 1'b1);
+			wait (dut_I.srst == 1'b0);
+			chk_ena = ena;
+		end
+	endtask
+
+	initial begin
+		// Nominal delay, wrapping the ring a few times
+		cfg_delay = 1000;
+		# 21 rst = 0;
+		chk_ena = 1;
+		wait (data_in == 20000);
+
+		if (stat_underflow | stat_overflow) begin
+			$display("[!] Unexpected underflow/overflow");
+			errors = errors + 1;
+		end
+
+		// Reload with another delay
+		restart(3000);
+		wait (data_in == 20000);
+
+		if (stat_underflow | stat_overflow) begin
+			$display("[!] Unexpected underflow/overflow");
+			errors = errors + 1;
+		end
+
+		chk_ena = 0;
+
+		// Too short for the memory round trip
+		restart(8);
+		wait (data_in == 2000);
+
+		if (!stat_underflow) begin
+			$display("[!] Missing underflow");
+			errors = errors + 1;
+		end
+
+		// Too long for the ring
+		restart(6000);
+		wait (data_in == 8000);
+
+		if (!stat_overflow) begin
+			$display("[!] Missing overflow");
+			errors = errors + 1;
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_delay_ddr_tb: PASS");
+		else
+			$display("[!] sig_delay_ddr_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_delay_ddr_tb
@@ -0,0 +1,304 @@
+/*
+ * sig_delay_iq.v
+ *
+ * Signal delay line - I/Q packed, runtime configurable length
+ *
+ * Same behavior as a pair of `sig_delay` (output for the n-th valid
+ * sample is input sample n - delay - 2) but stores three I/Q samples
+ * per 72 bits word of RAMB36E1 in SDP mode, using the parity bits too.
+ * That's 1536 samples per BRAM, vs 1365 for 24 BRAM in 1 bit mode.
+ *
+ * The ring holds 3 * 512 * ceil(DEPTH / 1536) samples and the maximum
+ * delay is that minus 2.
+ *
+ * `delay` is registered on valid samples : a new value applies from the
+ * output of the 4th valid sample after it's set, whatever the spacing of
+ * `data_valid`, so a delay stepping along with the samples keeps a fixed
+ * latency in samples (one more than `sig_delay`).
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_delay_iq #(
+	parameter integer WIDTH = 12,		// Per rail, must be <= 12
+	parameter integer DEPTH = 32768
+)(
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] data_in_i,
+	input  wire [WIDTH-1:0] data_in_q,
+	output reg  [WIDTH-1:0] data_out_i,
+	output reg  [WIDTH-1:0] data_out_q,
+	input  wire [15:0] delay,
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer N_BRAM = (DEPTH + 1535) / 1536;
+	localparam integer WORDS  = 512 * N_BRAM;
+	localparam integer AW     = $clog2(WORDS);
+	localparam integer SW     = 2 * WIDTH;
+
+	// Ring size modulo 2^AW, for the address arithmetic
+	localparam [AW-1:0] WORDS_AW = WORDS[AW-1:0];
+
+	// Signals
+	// -------
+
+	wire ce;
+
+	// Delay split in words / lanes
+	wire [32:0] dly_mult;
+	wire [15:0] dly_q;
+	wire [15:0] dly_r;
+	reg  [AW-1:0] dly_word;
+	reg  [ 1:0] dly_lane;
+	reg  dly_short;
+	reg  dly_odd;
+
+	// Write
+	wire [SW-1:0] wr_sample;
+	reg  [SW-1:0] wr_acc_0;
+	reg  [SW-1:0] wr_acc_1;
+	wire [71:0] wr_data;
+	wire wr_ena;
+	wire [N_BRAM-1:0] wr_bram_ena;
+	reg  [AW-1:0] wr_word;
+	reg  [ 1:0] wr_lane;
+
+	// Read address
+	wire [ 2:0] rd_lane_t;
+	wire [ 1:0] rd_lane_n;
+	wire [AW:0] rd_word_t;
+	wire [AW-1:0] rd_word_n;
+	wire rd_borrow;
+
+	// Read pipeline
+	reg  [AW-1:0] rd_word_0;
+	reg  [ 1:0] rd_lane_0;
+	reg  [ 1:0] rd_lane_1;
+	reg  [AW-10:0] rd_bram_1;
+	wire [71:0] rd_data_all [0:N_BRAM-1];
+	wire [71:0] rd_data;
+	reg  [SW-1:0] rd_sample;
+
+	// Short delays bypass
+	reg  [SW-1:0] hist_0;
+	reg  [SW-1:0] hist_1;
+	reg  [SW-1:0] hist_2;
+	reg  byp_0, byp_1;
+	reg  byp_sel_0, byp_sel_1;
+
+
+	// Control
+	// -------
+
+	assign ce = data_valid;
+
+	// delay / 3 (exact for 16 bits inputs)
+	assign dly_mult = { 17'd0, delay } * 33'd43691;
+	assign dly_q = dly_mult[32:17];
+	assign dly_r = delay - (dly_q + { dly_q[14:0], 1'b0 });
+
+	always @(posedge clk)
+	begin
+		if (ce) begin
+			dly_word  <= dly_q[AW-1:0];
+			dly_lane  <= dly_r[1:0];
+			dly_short <= (delay < 16'd2);
+			dly_odd   <= delay[0];
+		end
+	end
+
+	// Read position = write position - delay, in words / lanes
+	assign rd_lane_t = { 1'b0, wr_lane } - { 1'b0, dly_lane };
+	assign rd_borrow = rd_lane_t[2];
+	assign rd_lane_n = rd_borrow ? (rd_lane_t[1:0] + 2'd3) : rd_lane_t[1:0];
+
+	assign rd_word_t = { 1'b0, wr_word } - { 1'b0, dly_word } - { {AW{1'b0}}, rd_borrow };
+	assign rd_word_n = rd_word_t[AW] ? (rd_word_t[AW-1:0] + WORDS_AW) : rd_word_t[AW-1:0];
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			wr_word   <= 0;
+			wr_lane   <= 0;
+			rd_word_0 <= 0;
+			rd_lane_0 <= 0;
+		end else if (ce) begin
+			if (wr_lane == 2'd2) begin
+				wr_lane <= 0;
+				wr_word <= (wr_word == (WORDS_AW - 1'b1)) ? {AW{1'b0}} : (wr_word + 1'b1);
+			end else begin
+				wr_lane <= wr_lane + 1;
+			end
+
+			rd_word_0 <= rd_word_n;
+			rd_lane_0 <= rd_lane_n;
+		end
+	end
+
+
+	// Write
+	// -----
+
+	assign wr_sample = { data_in_q, data_in_i };
+
+	always @(posedge clk)
+	begin
+		if (ce & (wr_lane == 2'd0))
+			wr_acc_0 <= wr_sample;
+		if (ce & (wr_lane == 2'd1))
+			wr_acc_1 <= wr_sample;
+	end
+
+	assign wr_data = { { (72-3*SW){1'b0} }, wr_sample, wr_acc_1, wr_acc_0 };
+	assign wr_ena  = ce & (wr_lane == 2'd2);
+
+	assign wr_bram_ena = wr_ena ? ({ {(N_BRAM-1){1'b0}}, 1'b1 } << wr_word[AW-1:9]) : {N_BRAM{1'b0}};
+
+
+	// Short delays
+	// ------------
+
+	// With delay < 2, the word holding the sample isn't written yet when
+	// it's read, so take it from the last input samples instead
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			hist_0    <= 0;
+			hist_1    <= 0;
+			hist_2    <= 0;
+			byp_0     <= 1'b0;
+			byp_1     <= 1'b0;
+			byp_sel_0 <= 1'b0;
+			byp_sel_1 <= 1'b0;
+		end else if (ce) begin
+			hist_0    <= wr_sample;
+			hist_1    <= hist_0;
+			hist_2    <= hist_1;
+			byp_0     <= dly_short;
+			byp_1     <= byp_0;
+			byp_sel_0 <= dly_odd;
+			byp_sel_1 <= byp_sel_0;
+		end
+	end
+
+
+	// Output
+	// ------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			rd_lane_1 <= 0;
+			rd_bram_1 <= 0;
+		end else if (ce) begin
+			rd_lane_1 <= rd_lane_0;
+			rd_bram_1 <= rd_word_0[AW-1:9];
+		end
+	end
+
+	assign rd_data = rd_data_all[rd_bram_1];
+
+	always @(*)
+	begin
+		case (rd_lane_1)
+			2'd0:    rd_sample = rd_data[   0+:SW];
+			2'd1:    rd_sample = rd_data[  SW+:SW];
+			default: rd_sample = rd_data[2*SW+:SW];
+		endcase
+
+		if (byp_1)
+			rd_sample = byp_sel_1 ? hist_2 : hist_1;
+	end
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			data_out_i <= 0;
+			data_out_q <= 0;
+		end else if (ce) begin
+			data_out_i <= rd_sample[WIDTH-1:0];
+			data_out_q <= rd_sample[SW-1:WIDTH];
+		end
+	end
+
+
+	// Storage
+	// -------
+
+	genvar i;
+
+	generate
+		for (i=0; i<N_BRAM; i=i+1)
+		begin
+			// Signals
+			wire [63:0] ram_do;
+			wire [ 7:0] ram_dop;
+			wire ram_we;
+
+			// Connections
+			assign rd_data_all[i] = { ram_dop, ram_do };
+			assign ram_we = wr_bram_ena[i];
+
+			// Instantiate RAM Block
+			RAMB36E1 #(
+				.RDADDR_COLLISION_HWCONFIG("PERFORMANCE"),
+				.SIM_COLLISION_CHECK("NONE"),
+				.DOA_REG(0),
+				.DOB_REG(0),
+				.EN_ECC_READ("FALSE"),
+				.EN_ECC_WRITE("FALSE"),
+				.RAM_EXTENSION_A("NONE"),
+				.RAM_EXTENSION_B("NONE"),
+				.RAM_MODE("SDP"),
+				.READ_WIDTH_A(72),
+				.READ_WIDTH_B(0),
+				.WRITE_WIDTH_A(0),
+				.WRITE_WIDTH_B(72),
+				.RSTREG_PRIORITY_A("RSTREG"),
+				.RSTREG_PRIORITY_B("RSTREG"),
+				.SIM_DEVICE("7SERIES"),
+				.SRVAL_A(36'h000000000),
+				.SRVAL_B(36'h000000000),
+				.WRITE_MODE_A("READ_FIRST"),
+				.WRITE_MODE_B("READ_FIRST")
+			)
+			mem_elem_I (
+				.DOADO(ram_do[31:0]),
+				.DOPADOP(ram_dop[3:0]),
+				.DOBDO(ram_do[63:32]),
+				.DOPBDOP(ram_dop[7:4]),
+				.CASCADEINA(1'b0),
+				.CASCADEINB(1'b0),
+				.INJECTDBITERR(1'b0),
+				.INJECTSBITERR(1'b0),
+				.ADDRARDADDR({1'b1, rd_word_0[8:0], 6'b111111}),
+				.CLKARDCLK(clk),
+				.ENARDEN(ce),
+				.REGCEAREGCE(1'b0),
+				.RSTRAMARSTRAM(rst),
+				.RSTREGARSTREG(rst),
+				.WEA(4'd0),
+				.DIADI(wr_data[31:0]),
+				.DIPADIP(wr_data[67:64]),
+				.ADDRBWRADDR({1'b1, wr_word[8:0], 6'b111111}),
+				.CLKBWRCLK(clk),
+				.ENBWREN(ram_we),
+				.REGCEB(1'b0),
+				.RSTRAMB(rst),
+				.RSTREGB(rst),
+				.WEBWE({8{ram_we}}),
+				.DIBDI(wr_data[63:32]),
+				.DIPBDIP(wr_data[71:68])
+			);
+		end
+	endgenerate
+
+endmodule // sig_delay_iq
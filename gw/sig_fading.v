@@ -0,0 +1,332 @@
+/*
+ * sig_fading.v
+ *
+ * Rayleigh / Rician fading of an I/Q stream
+ *
+ * Multiplies the samples by a time varying complex gain
+ *
+ *   h = los + diffuse * 1/sqrt(N) * sum_m exp(j * (2 pi f_m t + phi_m))
+ *
+ * which is a sum of sinusoids model of the classical (Jakes) Doppler
+ * spectrum : N = 2^M_LOG oscillators at f_m = doppler * cos(alpha_m),
+ * alpha_m = 2 pi (m + 1/4) / N, with fixed pseudo random initial phases.
+ * With `los` = 0 the envelope is Rayleigh, otherwise Rician with
+ * K = los^2 / diffuse^2. `los` and `diffuse` are Q2.14, for a unit mean
+ * power use los = sqrt(K / (K+1)) and diffuse = sqrt(1 / (K+1)).
+ *
+ * `doppler` is the maximum Doppler shift in turns per sample * 2^32. The
+ * oscillators are updated in turn, one per valid sample, so `h` is
+ * refreshed every N samples, which is plenty for Doppler rates well below
+ * the sample rate / N.
+ *
+ * Total latency is 5 clock cycles. |h| can exceed 1, the output saturates.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_fading #(
+	parameter integer D_WIDTH   = 12,
+	parameter integer M_LOG     = 4,		// Even
+	parameter integer PHASE_LOG = 10,
+	parameter [31:0]  SEED      = 32'h00000000
+)(
+	// Input
+	input  wire data_valid,
+	input  wire [D_WIDTH-1:0] in_data_i,
+	input  wire [D_WIDTH-1:0] in_data_q,
+
+	// Output
+	output wire [D_WIDTH-1:0] out_data_i,
+	output wire [D_WIDTH-1:0] out_data_q,
+	output wire [1:0] out_sat,
+
+	// Config
+	input  wire [23:0] doppler,
+	input  wire [15:0] los,
+	input  wire [15:0] diffuse,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer N  = 1 << M_LOG;
+	localparam integer AW = 16 + M_LOG;		// Sum of N Q2.14
+
+	// Signals
+	// -------
+
+	// Oscillators
+	reg  [M_LOG-1:0] osc_idx;
+	reg  [31:0] osc_phase [0:N-1];
+	reg  [15:0] osc_cos [0:N-1];
+	reg  [31:0] nco_rom [0:(1<<PHASE_LOG)-1];
+
+	reg  v_1;
+	reg  [M_LOG-1:0] idx_1;
+	reg  [31:0] phase_1;
+	reg  signed [15:0] cos_a_1;
+
+	reg  v_2;
+	reg  [M_LOG-1:0] idx_2;
+	reg  [31:0] phase_2;
+	reg  signed [40:0] fm_2;
+	reg  [31:0] nco_data_2;
+	wire signed [15:0] nco_cos_2;
+	wire signed [15:0] nco_sin_2;
+	wire [31:0] dphase_2;
+
+	// Sum and gain
+	reg  signed [AW-1:0] acc_i_3;
+	reg  signed [AW-1:0] acc_q_3;
+	reg  last_3;
+
+	reg  signed [AW-M_LOG/2-1:0] hd_i_4;
+	reg  signed [AW-M_LOG/2-1:0] hd_q_4;
+	reg  upd_4;
+
+	reg  signed [AW-M_LOG/2+15:0] m_i_5;
+	reg  signed [AW-M_LOG/2+15:0] m_q_5;
+	reg  upd_5;
+
+	reg  signed [AW-M_LOG/2+2:0] g_i_6;
+	reg  signed [AW-M_LOG/2+2:0] g_q_6;
+	reg  upd_6;
+
+	reg  [15:0] h_i;
+	reg  [15:0] h_q;
+
+	// Data (aligned with the cascades)
+	reg  [D_WIDTH-1:0] data_i_1, data_i_2;
+	reg  [D_WIDTH-1:0] data_q_1, data_q_2;
+	reg  [15:0] h_i_1;
+	reg  [15:0] h_q_1, h_q_2;
+	reg  [15:0] h_nq_1, h_nq_2;
+
+	// Cascades
+	wire [47:0] pc_i;
+	wire [47:0] pc_q;
+
+
+	// Tables
+	// ------
+
+	function integer round;
+		input real v;
+		round = (v >= 0.0) ? $rtoi(v + 0.5) : -$rtoi(0.5 - v);
+	endfunction
+
+	integer n;
+	real w;
+
+	initial
+	begin
+		// cos / sin table, Q2.14
+		for (n=0; n<(1<<PHASE_LOG); n=n+1)
+		begin
+			w = 6.283185307179586 * n / (1 << PHASE_LOG);
+			nco_rom[n][15: 0] = round(16384.0 * $cos(w));
+			nco_rom[n][31:16] = round(16384.0 * $sin(w));
+		end
+
+		// Arrival angles and initial phases
+		for (n=0; n<N; n=n+1)
+		begin
+			w = 6.283185307179586 * (n + 0.25) / N;
+			osc_cos[n]   = round(16384.0 * $cos(w));
+			osc_phase[n] = (n * 32'h9e3779b9) ^ SEED;
+		end
+	end
+
+
+	// Oscillators
+	// -----------
+
+	always @(posedge clk)
+	begin
+		if (rst)
+			osc_idx <= 0;
+		else if (data_valid)
+			osc_idx <= osc_idx + 1;
+	end
+
+	// Stage 1 : Read oscillator state
+	always @(posedge clk)
+	begin
+		v_1     <= data_valid & ~rst;
+		idx_1   <= osc_idx;
+		phase_1 <= osc_phase[osc_idx];
+		cos_a_1 <= osc_cos[osc_idx];
+	end
+
+	// Stage 2 : Frequency and cos / sin
+	always @(posedge clk)
+	begin
+		v_2        <= v_1;
+		idx_2      <= idx_1;
+		phase_2    <= phase_1;
+		fm_2       <= $signed({ 1'b0, doppler }) * cos_a_1;
+		nco_data_2 <= nco_rom[phase_1[31:32-PHASE_LOG]];
+	end
+
+	assign nco_cos_2 = nco_data_2[15: 0];
+	assign nco_sin_2 = nco_data_2[31:16];
+
+	// Phase step over N samples (sign extended, modulo 2^32)
+	assign dphase_2 = fm_2 >>> (14 - M_LOG);
+
+	// Stage 3 : Advance by N samples and sum, the same oscillator is
+	// only read again N valid samples later
+	always @(posedge clk)
+	begin
+		if (v_2) begin
+			osc_phase[idx_2] <= phase_2 + dphase_2;
+
+			acc_i_3 <= (idx_2 == 0) ? nco_cos_2 : (acc_i_3 + nco_cos_2);
+			acc_q_3 <= (idx_2 == 0) ? nco_sin_2 : (acc_q_3 + nco_sin_2);
+		end
+
+		last_3 <= v_2 & (&idx_2);
+	end
+
+	// Stage 4-6 : Normalize, scale and add the line of sight
+	always @(posedge clk)
+	begin
+		upd_4 <= last_3;
+		upd_5 <= upd_4;
+		upd_6 <= upd_5;
+
+		if (last_3) begin
+			hd_i_4 <= acc_i_3 >>> (M_LOG / 2);
+			hd_q_4 <= acc_q_3 >>> (M_LOG / 2);
+		end
+
+		m_i_5 <= $signed(diffuse) * hd_i_4;
+		m_q_5 <= $signed(diffuse) * hd_q_4;
+
+		g_i_6 <= (m_i_5 >>> 14) + $signed(los);
+		g_q_6 <= (m_q_5 >>> 14);
+	end
+
+	// Gain, symmetrically saturated so it can be negated
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			h_i <= 16'h0000;
+			h_q <= 16'h0000;
+		end else if (upd_6) begin
+			if (g_i_6 > $signed(32767))
+				h_i <= 16'h7fff;
+			else if (g_i_6 < -$signed(32767))
+				h_i <= 16'h8001;
+			else
+				h_i <= g_i_6[15:0];
+
+			if (g_q_6 > $signed(32767))
+				h_q <= 16'h7fff;
+			else if (g_q_6 < -$signed(32767))
+				h_q <= 16'h8001;
+			else
+				h_q <= g_q_6[15:0];
+		end
+	end
+
+
+	// Data
+	// ----
+
+	always @(posedge clk)
+	begin
+		data_i_1 <= in_data_i;
+		data_i_2 <= data_i_1;
+		data_q_1 <= in_data_q;
+		data_q_2 <= data_q_1;
+
+		h_i_1  <= h_i;
+		h_q_1  <= h_q;
+		h_q_2  <= h_q_1;
+		h_nq_1 <= -h_q;
+		h_nq_2 <= h_nq_1;
+	end
+
+
+	// Complex multiply
+	// ----------------
+
+	// I = i * h_i - q * h_q
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("DIRECT")
+	) mult_ii_I (
+		.in_data_0(data_i_1),
+		.in_scale_0(h_i_1),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(48'h000000000000),
+		.out_3(),
+		.out_sat_3(),
+		.out_pcout_3(pc_i),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("CASCADE")
+	) mult_qi_I (
+		.in_data_0(data_q_2),
+		.in_scale_0(h_nq_2),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(pc_i),
+		.out_3(out_data_i),
+		.out_sat_3(out_sat[0]),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Q = q * h_i + i * h_q
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("DIRECT")
+	) mult_qq_I (
+		.in_data_0(data_q_1),
+		.in_scale_0(h_i_1),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(48'h000000000000),
+		.out_3(),
+		.out_sat_3(),
+		.out_pcout_3(pc_q),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("CASCADE")
+	) mult_iq_I (
+		.in_data_0(data_i_2),
+		.in_scale_0(h_q_2),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(pc_q),
+		.out_3(out_data_q),
+		.out_sat_3(out_sat[1]),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+endmodule // sig_fading
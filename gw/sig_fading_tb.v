@@ -0,0 +1,174 @@
+/*
+ * sig_fading_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_fading_tb;
+
+	localparam integer LATENCY = 5;
+	localparam integer N = 100000;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid = 1'b0;
+	reg  [11:0] in_data_i;
+	reg  [11:0] in_data_q;
+	wire [11:0] out_data_i;
+	wire [11:0] out_data_q;
+	wire [1:0] out_sat;
+
+	reg  [23:0] doppler;
+	reg  [15:0] los;
+	reg  [15:0] diffuse;
+
+	reg  [11:0] exp_i [0:LATENCY-1];
+	reg  [11:0] exp_q [0:LATENCY-1];
+
+	integer errors = 0;
+	integer k;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_fading_tb.vcd");
+		$dumpvars(0,sig_fading_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_fading #(
+		.D_WIDTH(12),
+		.M_LOG(4),
+		.PHASE_LOG(10)
+	) dut_I (
+		.data_valid(data_valid),
+		.in_data_i(in_data_i),
+		.in_data_q(in_data_q),
+		.out_data_i(out_data_i),
+		.out_data_q(out_data_q),
+		.out_sat(out_sat),
+		.doppler(doppler),
+		.los(los),
+		.diffuse(diffuse),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Expected output without fading
+	always @(posedge clk)
+	begin
+		exp_i[0] <= in_data_i;
+		exp_q[0] <= in_data_q;
+		for (k=1; k<LATENCY; k=k+1) begin
+			exp_i[k] <= exp_i[k-1];
+			exp_q[k] <= exp_q[k-1];
+		end
+	end
+
+	// Measure |h|^2 statistics over N samples, with a constant input of 512
+	real p, p_sum, p_prev;
+	integer n_deep, n_cross;
+
+	task measure;
+		integer n;
+		real hi, hq;
+		begin
+			in_data_i = 12'd512;
+			in_data_q = 12'd0;
+			repeat (64) @(posedge clk);
+
+			p_sum = 0.0;
+			p_prev = 0.0;
+			n_deep = 0;
+			n_cross = 0;
+
+			for (n=0; n<N; n=n+1) begin
+				@(posedge clk);
+				#1;
+				hi = $itor($signed(out_data_i)) / 512.0;
+				hq = $itor($signed(out_data_q)) / 512.0;
+				p = hi * hi + hq * hq;
+				p_sum = p_sum + p;
+				if (p < 0.1)
+					n_deep = n_deep + 1;
+				if ((n > 0) && (p_prev >= 1.0) && (p < 1.0))
+					n_cross = n_cross + 1;
+				p_prev = p;
+			end
+
+			p_sum = p_sum / N;
+		end
+	endtask
+
+	initial begin
+		in_data_i = 0;
+		in_data_q = 0;
+		doppler = 24'd0;
+		los = 16'd16384;
+		diffuse = 16'd0;
+
+		# 21 rst = 0;
+		data_valid = 1'b1;
+		# 100;
+
+		// LOS only : transparent, LATENCY cycles
+		for (k=0; k<1000; k=k+1) begin
+			@(posedge clk);
+			in_data_i <= $random;
+			in_data_q <= $random;
+			#1;
+			if ((k > LATENCY + 32) &&
+			    ((out_data_i !== exp_i[LATENCY-1]) || (out_data_q !== exp_q[LATENCY-1]))) begin
+				$display("[!] LOS only : %0d / %0d, expected %0d / %0d",
+					$signed(out_data_i), $signed(out_data_q),
+					$signed(exp_i[LATENCY-1]), $signed(exp_q[LATENCY-1]));
+				errors = errors + 1;
+			end
+		end
+
+		// Rayleigh, max Doppler 1/1024 turns per sample : unit power,
+		// P(|h|^2 < 0.1) = 1 - exp(-0.1), ~0.92 * fd * N crossings of
+		// the mean power
+		doppler = 24'h400000;
+		los = 16'd0;
+		diffuse = 16'd16384;
+		measure;
+
+		if ((p_sum < 0.9) || (p_sum > 1.1) ||
+		    (n_deep < 0.06 * N) || (n_deep > 0.13 * N) ||
+		    (n_cross < 60) || (n_cross > 120)) begin
+			$display("[!] Rayleigh : power %f, %0d deep fades, %0d crossings", p_sum, n_deep, n_cross);
+			errors = errors + 1;
+		end
+
+		// Rician, K = 10
+		los = 16'd15622;
+		diffuse = 16'd4940;
+		measure;
+
+		if ((p_sum < 0.9) || (p_sum > 1.1) || (n_deep > 0.01 * N)) begin
+			$display("[!] Rician : power %f, %0d deep fades", p_sum, n_deep);
+			errors = errors + 1;
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_fading_tb: PASS");
+		else
+			$display("[!] sig_fading_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_fading_tb
@@ -0,0 +1,195 @@
+/*
+ * sig_farrow.v
+ *
+ * Fractional delay - cubic Lagrange interpolator in Farrow structure
+ *
+ * Delays the signal by 1 + mu samples, mu being `frac` / 2^16, with the
+ * polynomial evaluated in Horner form :
+ *
+ *   y = x1 + mu * (c1 + mu * (c2 + mu * c3)) / 6
+ *
+ *   c1 = -2 x0 - 3 x1 + 6 x2 - x3
+ *   c2 =  3 x0 - 6 x1 + 3 x2
+ *   c3 = -  x0 + 3 x1 - 3 x2 + x3
+ *
+ * (x0 being the most recent sample). The pipeline advances with
+ * `data_valid` so the total delay is exactly LATENCY + mu samples, up
+ * to the output register : in place of a wire between two blocks, the
+ * filter adds LATENCY + 1 + mu samples. The output saturates, `data_sat`
+ * flags when it does.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_farrow #(
+	parameter integer WIDTH = 12
+)(
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] data_in,
+	output reg  [WIDTH-1:0] data_out,
+	output reg  data_sat,
+	input  wire [15:0] frac,
+	input  wire clk,
+	input  wire rst
+);
+
+	// Total delay for frac = 0 : interpolation point + 8 pipeline stages
+	localparam integer LATENCY = 9;
+
+	// Extra fractional bits kept through the Horner evaluation
+	localparam integer F = 4;
+
+	// 1/6 in Q0.16
+	localparam integer INV6 = 10923;
+
+	localparam integer CW = WIDTH + 4;		// c1..c3
+	localparam integer TW = CW + F + 2;		// Horner terms
+
+	// Signals
+	// -------
+
+	wire ce;
+
+	// History
+	reg  signed [WIDTH-1:0] x0, x1, x2, x3;
+
+	// Stage 1 : Coefficients
+	reg  signed [CW-1:0] c1_1, c2_1, c3_1;
+	reg  signed [WIDTH-1:0] y_1;
+	reg  signed [16:0] mu_1;
+
+	// Stage 2 : mu * c3
+	reg  signed [CW+16:0] p3_2;
+	reg  signed [CW-1:0] c1_2, c2_2;
+	reg  signed [WIDTH-1:0] y_2;
+	reg  signed [16:0] mu_2;
+
+	// Stage 3 : c2 + ...
+	reg  signed [TW-1:0] t2_3;
+	reg  signed [CW-1:0] c1_3;
+	reg  signed [WIDTH-1:0] y_3;
+	reg  signed [16:0] mu_3;
+
+	// Stage 4 : mu * (c2 + ...)
+	reg  signed [TW+16:0] p2_4;
+	reg  signed [CW-1:0] c1_4;
+	reg  signed [WIDTH-1:0] y_4;
+	reg  signed [16:0] mu_4;
+
+	// Stage 5 : c1 + ...
+	reg  signed [TW-1:0] t1_5;
+	reg  signed [WIDTH-1:0] y_5;
+	reg  signed [16:0] mu_5;
+
+	// Stage 6 : mu * (c1 + ...)
+	reg  signed [TW+16:0] p1_6;
+	reg  signed [WIDTH-1:0] y_6;
+
+	// Stage 7 : / 6
+	reg  signed [TW+16:0] p0_7;
+	reg  signed [WIDTH-1:0] y_7;
+
+	// Stage 8 : x1 + ... and saturation
+	wire signed [TW:0] y_sum;
+
+
+	// Control
+	// -------
+
+	assign ce = data_valid;
+
+
+	// History
+	// -------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			x0 <= 0;
+			x1 <= 0;
+			x2 <= 0;
+			x3 <= 0;
+		end else if (ce) begin
+			x0 <= data_in;
+			x1 <= x0;
+			x2 <= x1;
+			x3 <= x2;
+		end
+	end
+
+
+	// Pipeline
+	// --------
+
+	always @(posedge clk)
+	begin
+		if (ce) begin
+			// Stage 1
+			c1_1 <= -2 * x0 - 3 * x1 + 6 * x2 - x3;
+			c2_1 <=  3 * x0 - 6 * x1 + 3 * x2;
+			c3_1 <= -x0 + 3 * x1 - 3 * x2 + x3;
+			y_1  <= x1;
+			mu_1 <= $signed({ 1'b0, frac });
+
+			// Stage 2
+			p3_2 <= mu_1 * c3_1;
+			c1_2 <= c1_1;
+			c2_2 <= c2_1;
+			y_2  <= y_1;
+			mu_2 <= mu_1;
+
+			// Stage 3
+			t2_3 <= (c2_2 <<< F) + (p3_2 >>> (16 - F));
+			c1_3 <= c1_2;
+			y_3  <= y_2;
+			mu_3 <= mu_2;
+
+			// Stage 4
+			p2_4 <= mu_3 * t2_3;
+			c1_4 <= c1_3;
+			y_4  <= y_3;
+			mu_4 <= mu_3;
+
+			// Stage 5
+			t1_5 <= (c1_4 <<< F) + (p2_4 >>> 16);
+			y_5  <= y_4;
+			mu_5 <= mu_4;
+
+			// Stage 6
+			p1_6 <= mu_5 * t1_5;
+			y_6  <= y_5;
+
+			// Stage 7
+			p0_7 <= (p1_6 >>> 16) * INV6;
+			y_7  <= y_6;
+		end
+	end
+
+	// Stage 8
+	assign y_sum = y_7 + ((p0_7 + (1 << (15 + F))) >>> (16 + F));
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			data_out <= 0;
+			data_sat <= 1'b0;
+		end else if (ce) begin
+			if (y_sum > $signed((1 << (WIDTH-1)) - 1))
+				data_out <= (1 << (WIDTH-1)) - 1;
+			else if (y_sum < -$signed(1 << (WIDTH-1)))
+				data_out <= 1 << (WIDTH-1);
+			else
+				data_out <= y_sum[WIDTH-1:0];
+
+			data_sat <= (y_sum > $signed((1 << (WIDTH-1)) - 1)) ||
+			            (y_sum < -$signed(1 << (WIDTH-1)));
+		end
+	end
+
+endmodule // sig_farrow
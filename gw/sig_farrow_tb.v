@@ -0,0 +1,169 @@
+/*
+ * sig_farrow_tb.v
+ *
+ * Measures the group delay of the fractional delay filter on test tones
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_farrow_tb;
+
+	localparam real PI = 3.141592653589793;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	wire [11:0] data_in;
+	wire [11:0] data_out;
+	reg  [15:0] cfg_frac;
+
+	integer n;
+	real tone_freq = 0.05;		// cycles / sample
+
+	reg  chk;
+	integer chk_n;
+	integer acc_cnt = 0;
+	real acc_c = 0.0;
+	real acc_s = 0.0;
+
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_farrow_tb.vcd");
+		$dumpvars(0,sig_farrow_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_farrow #(
+		.WIDTH(12)
+	) dut_I (
+		.data_valid(data_valid),
+		.data_in(data_in),
+		.data_out(data_out),
+		.data_sat(),
+		.frac(cfg_frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Data gen : test tone, random valid
+	function [11:0] tone;
+		input integer idx;
+		real v;
+		begin
+			v = 1500.0 * $sin(2.0 * PI * tone_freq * idx);
+			tone = (v >= 0.0) ? $rtoi(v + 0.5) : -$rtoi(0.5 - v);
+		end
+	endfunction
+
+	always @(posedge clk)
+		if (rst)
+			n <= 0;
+		else if (data_valid)
+			n <= n + 1;
+
+	assign data_in = tone(n);
+
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ($random & 3) == 0;
+
+	// Correlation of the output with the tone
+	always @(posedge clk)
+	begin
+		chk   <= data_valid;
+		chk_n <= n;
+	end
+
+	always @(negedge clk)
+	begin
+		if (chk) begin
+			acc_c = acc_c + $signed(data_out) * $cos(2.0 * PI * tone_freq * chk_n);
+			acc_s = acc_s + $signed(data_out) * $sin(2.0 * PI * tone_freq * chk_n);
+			acc_cnt = acc_cnt + 1;
+		end
+	end
+
+	// Scenario
+	task measure;
+		input real freq;
+		input [15:0] frac;
+		input real tol;
+		real mu, w, d, period, expected;
+		begin
+			tone_freq = freq;
+			cfg_frac  = frac;
+
+			// Let the pipeline settle
+			acc_cnt = 0;
+			wait (acc_cnt == 32);
+
+			acc_c = 0.0;
+			acc_s = 0.0;
+			acc_cnt = 0;
+			wait (acc_cnt == 4000);
+
+			// out = sin(w * (n - d))  =>  w * d = atan2(-c, s)
+			w = 2.0 * PI * freq;
+			d = $atan2(-acc_c, acc_s) / w;
+
+			// Unwrap around the expected value
+			mu = frac / 65536.0;
+			expected = 9.0 + mu;
+			period = 1.0 / freq;
+			while (d < expected - period / 2.0)
+				d = d + period;
+			while (d > expected + period / 2.0)
+				d = d - period;
+
+			$display("[.] Tone %.3f, mu %.4f : delay %.4f samples (error %.4f)",
+				freq, mu, d, d - expected);
+
+			if ((d < expected - tol) || (d > expected + tol)) begin
+				$display("[!] Delay error too large");
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	initial begin
+		cfg_frac = 0;
+		# 21 rst = 0;
+
+		measure(0.05, 16'h0000, 0.005);
+		measure(0.05, 16'h1999, 0.005);
+		measure(0.05, 16'h4000, 0.005);
+		measure(0.05, 16'h8000, 0.005);
+		measure(0.05, 16'hc000, 0.005);
+		measure(0.05, 16'hffff, 0.005);
+
+		measure(0.15, 16'h0000, 0.01);
+		measure(0.15, 16'h4000, 0.01);
+		measure(0.15, 16'h8000, 0.01);
+		measure(0.15, 16'hc000, 0.01);
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_farrow_tb: PASS");
+		else
+			$display("[!] sig_farrow_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_farrow_tb
@@ -0,0 +1,76 @@
+/*
+ * sig_fifo.v
+ *
+ * Small synchronous FIFO (first-word fall-through, distributed RAM)
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_fifo #(
+	parameter integer WIDTH  = 64,
+	parameter integer AWIDTH = 6
+)(
+	// Write
+	input  wire [WIDTH-1:0] wr_data,
+	input  wire wr_ena,
+	output wire full,
+
+	// Read
+	output wire [WIDTH-1:0] rd_data,
+	input  wire rd_ena,
+	output wire empty,
+
+	// Status
+	output wire [AWIDTH:0] level,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	reg [WIDTH-1:0] mem [0:(1<<AWIDTH)-1];
+
+	reg [AWIDTH:0] wr_ptr;
+	reg [AWIDTH:0] rd_ptr;
+
+
+	// Pointers
+	// --------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			wr_ptr <= 0;
+			rd_ptr <= 0;
+		end else begin
+			if (wr_ena)
+				wr_ptr <= wr_ptr + 1;
+			if (rd_ena)
+				rd_ptr <= rd_ptr + 1;
+		end
+	end
+
+	assign level = wr_ptr - rd_ptr;
+	assign full  = level[AWIDTH];
+	assign empty = (wr_ptr == rd_ptr);
+
+
+	// Storage
+	// -------
+
+	always @(posedge clk)
+		if (wr_ena)
+			mem[wr_ptr[AWIDTH-1:0]] <= wr_data;
+
+	assign rd_data = mem[rd_ptr[AWIDTH-1:0]];
+
+endmodule // sig_fifo
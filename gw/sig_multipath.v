@@ -0,0 +1,183 @@
+/*
+ * sig_multipath.v
+ *
+ * Multi-tap channel : sum of N_TAPS delayed and scaled copies of the
+ * I/Q input, added to the chain input.
+ *
+ * The taps read from a short common window (2^TAP_LOG samples, distributed
+ * RAM) so their delays are relative to the input, which is normally the
+ * output of the main delay line. The sum goes through a systolic DSP48
+ * cascade (one `sig_combine` per tap and rail, PCOUT -> PCIN), so it runs
+ * at full rate whatever the number of taps, with a latency of N_TAPS + 3
+ * clock cycles. The output saturates.
+ *
+ * `in_gate` comes with each input sample and is kept along with it in the
+ * window : a tap reading a sample with the gate low adds nothing, so the
+ * taps of a gated echo are muted with it, each for its own delay.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_multipath #(
+	parameter integer N_TAPS  = 6,
+	parameter integer TAP_LOG = 8,
+	parameter integer D_WIDTH = 12,
+	parameter integer S_WIDTH = 16,
+	parameter integer S_FRAC  = 14
+)(
+	// Input
+	input  wire data_valid,
+	input  wire [D_WIDTH-1:0] in_data_i,
+	input  wire [D_WIDTH-1:0] in_data_q,
+	input  wire in_gate,
+	input  wire [D_WIDTH-1:0] in_chain_i,
+	input  wire [D_WIDTH-1:0] in_chain_q,
+
+	// Output
+	output wire [D_WIDTH-1:0] out_data_i,
+	output wire [D_WIDTH-1:0] out_data_q,
+	output wire [1:0] out_sat,
+
+	// Taps config
+	input  wire [N_TAPS*TAP_LOG-1:0] tap_delay,
+	input  wire [N_TAPS*S_WIDTH-1:0] tap_scale,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer SW = 2 * D_WIDTH;
+	localparam integer GW = SW + 1;		// Sample and gate
+
+	// Signals
+	// -------
+
+	// Window
+	reg  [GW-1:0] win_mem [0:(1<<TAP_LOG)-1];
+	reg  [TAP_LOG-1:0] win_wr_ptr;
+
+	// Chain
+	reg  [D_WIDTH-1:0] chain_i_0;
+	reg  [D_WIDTH-1:0] chain_q_0;
+
+	// DSP cascade
+	wire [48*(N_TAPS+1)-1:0] pc_i;
+	wire [48*(N_TAPS+1)-1:0] pc_q;
+	wire [D_WIDTH*N_TAPS-1:0] out_i;
+	wire [D_WIDTH*N_TAPS-1:0] out_q;
+	wire [N_TAPS-1:0] sat_i;
+	wire [N_TAPS-1:0] sat_q;
+
+
+	// Window
+	// ------
+
+	always @(posedge clk)
+	begin
+		if (rst)
+			win_wr_ptr <= 0;
+		else if (data_valid)
+			win_wr_ptr <= win_wr_ptr + 1;
+	end
+
+	always @(posedge clk)
+		if (data_valid)
+			win_mem[win_wr_ptr] <= { in_gate, in_data_q, in_data_i };
+
+
+	// Chain input
+	// -----------
+
+	// Same register stage as the taps data
+	always @(posedge clk)
+	begin
+		chain_i_0 <= in_chain_i;
+		chain_q_0 <= in_chain_q;
+	end
+
+	assign pc_i[47:0] = 48'h000000000000;
+	assign pc_q[47:0] = 48'h000000000000;
+
+
+	// Taps
+	// ----
+
+	genvar k;
+
+	generate
+		for (k=0; k<N_TAPS; k=k+1)
+		begin : tap
+			// Signals
+			reg  [TAP_LOG-1:0] rd_ptr;
+			wire [GW-1:0] rd_data;
+			reg  [(k+1)*GW-1:0] stagger;
+			wire [GW-1:0] tap_data;
+			wire [S_WIDTH-1:0] tap_scale_k;
+
+			// Read pointer, updated with each new sample
+			always @(posedge clk)
+			begin
+				if (rst)
+					rd_ptr <= 0;
+				else if (data_valid)
+					rd_ptr <= win_wr_ptr - tap_delay[k*TAP_LOG+:TAP_LOG];
+			end
+
+			assign rd_data = win_mem[rd_ptr];
+
+			// Delay tap k by k cycles to match the cascade
+			always @(posedge clk)
+				stagger <= (stagger << GW) | rd_data;
+
+			assign tap_data = stagger[k*GW+:GW];
+			assign tap_scale_k = tap_data[SW] ? tap_scale[k*S_WIDTH+:S_WIDTH] : {S_WIDTH{1'b0}};
+
+			// Combiners
+			sig_combine #(
+				.D_WIDTH(D_WIDTH),
+				.S_WIDTH(S_WIDTH),
+				.S_FRAC(S_FRAC),
+				.CHAIN_INPUT((k == 0) ? "DIRECT" : "CASCADE")
+			) combine_i_I (
+				.in_data_0(tap_data[D_WIDTH-1:0]),
+				.in_scale_0(tap_scale_k),
+				.in_chain_0(chain_i_0),
+				.in_pcin_2(pc_i[48*k+:48]),
+				.out_3(out_i[D_WIDTH*k+:D_WIDTH]),
+				.out_sat_3(sat_i[k]),
+				.out_pcout_3(pc_i[48*(k+1)+:48]),
+				.clk(clk),
+				.rst(rst)
+			);
+
+			sig_combine #(
+				.D_WIDTH(D_WIDTH),
+				.S_WIDTH(S_WIDTH),
+				.S_FRAC(S_FRAC),
+				.CHAIN_INPUT((k == 0) ? "DIRECT" : "CASCADE")
+			) combine_q_I (
+				.in_data_0(tap_data[SW-1:D_WIDTH]),
+				.in_scale_0(tap_scale_k),
+				.in_chain_0(chain_q_0),
+				.in_pcin_2(pc_q[48*k+:48]),
+				.out_3(out_q[D_WIDTH*k+:D_WIDTH]),
+				.out_sat_3(sat_q[k]),
+				.out_pcout_3(pc_q[48*(k+1)+:48]),
+				.clk(clk),
+				.rst(rst)
+			);
+		end
+	endgenerate
+
+	assign out_data_i = out_i[D_WIDTH*(N_TAPS-1)+:D_WIDTH];
+	assign out_data_q = out_q[D_WIDTH*(N_TAPS-1)+:D_WIDTH];
+	assign out_sat    = { sat_q[N_TAPS-1], sat_i[N_TAPS-1] };
+
+endmodule // sig_multipath
@@ -0,0 +1,169 @@
+/*
+ * sig_multipath_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_multipath_tb;
+
+	localparam integer N_TAPS  = 6;
+	localparam integer TAP_LOG = 8;
+	localparam integer N_SAMPLES = 640;
+	localparam integer N_START   = 288;	// Window filled, no more X
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  [1:0] data_cnt;
+	wire data_valid;
+	reg  [11:0] data_in_i;
+	reg  [11:0] data_in_q;
+	reg  data_gate;
+	wire [11:0] data_out_i;
+	wire [11:0] data_out_q;
+
+	reg  [N_TAPS*TAP_LOG-1:0] cfg_tap_delay;
+	reg  [N_TAPS*16-1:0] cfg_tap_scale;
+
+	integer n = 0;
+	integer errors = 0;
+	integer base;
+	integer i, k;
+
+	reg signed [11:0] cap_i [0:N_SAMPLES-1];
+	reg signed [11:0] cap_q [0:N_SAMPLES-1];
+	reg signed [11:0] exp_i [0:N_SAMPLES-1];
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_multipath_tb.vcd");
+		$dumpvars(0,sig_multipath_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_multipath #(
+		.N_TAPS(N_TAPS),
+		.TAP_LOG(TAP_LOG),
+		.D_WIDTH(12),
+		.S_WIDTH(16),
+		.S_FRAC(14)
+	) dut_I (
+		.data_valid(data_valid),
+		.in_data_i(data_in_i),
+		.in_data_q(data_in_q),
+		.in_gate(data_gate),
+		.in_chain_i(12'd0),
+		.in_chain_q(12'd0),
+		.out_data_i(data_out_i),
+		.out_data_q(data_out_q),
+		.out_sat(),
+		.tap_delay(cfg_tap_delay),
+		.tap_scale(cfg_tap_scale),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Data gen : one sample every 4 cycles, single impulse on I, a second
+	// one gated which must not show on any tap
+	always @(posedge clk)
+		if (rst)
+			data_cnt <= 0;
+		else
+			data_cnt <= data_cnt + 1;
+
+	assign data_valid = (data_cnt == 2'd3);
+
+	always @(posedge clk)
+	begin
+		if (data_valid) begin
+			data_in_i <= ((n == 300) || (n == 330)) ? 12'd1000 : 12'd0;
+			data_in_q <= 12'd0;
+			data_gate <= (n != 330);
+		end
+	end
+
+	// Capture
+	always @(posedge clk)
+	begin
+		if (data_valid & ~rst & (n < N_SAMPLES)) begin
+			cap_i[n] <= data_out_i;
+			cap_q[n] <= data_out_q;
+			n <= n + 1;
+		end
+	end
+
+	// Scenario
+	initial begin
+		// Taps : delay / scale (Q2.14)
+		cfg_tap_delay = { 8'd255, 8'd100, 8'd50, 8'd10, 8'd3, 8'd0 };
+		cfg_tap_scale = { 16'h0400, 16'h0800, 16'he000, 16'h1000, 16'h2000, 16'h4000 };
+
+		data_in_i = 0;
+		data_in_q = 0;
+		data_gate = 1;
+
+		# 21 rst = 0;
+		wait (n == N_SAMPLES);
+
+		// Expected impulse response
+		for (i=0; i<N_SAMPLES; i=i+1)
+			exp_i[i] = 0;
+
+		exp_i[  0] =  1000;
+		exp_i[  3] =   500;
+		exp_i[ 10] =   250;
+		exp_i[ 50] =  -500;
+		exp_i[100] =   125;
+		exp_i[255] =    62;	// floor(62.5)
+
+		// Find the main tap
+		base = -1;
+		for (i=N_SAMPLES-1; i>=N_START; i=i-1)
+			if (cap_i[i] == 1000)
+				base = i;
+
+		if (base < 0) begin
+			$display("[!] Main tap not found");
+			errors = errors + 1;
+		end else begin
+			$display("[.] Main tap at sample %0d", base);
+
+			for (i=N_START; i<N_SAMPLES; i=i+1)
+			begin
+				k = i - base;
+				if ((k >= 0) && (cap_i[i] !== exp_i[k])) begin
+					$display("[!] Offset %0d : got %0d, expected %0d", k, cap_i[i], exp_i[k]);
+					errors = errors + 1;
+				end
+				if ((k < 0) && (cap_i[i] !== 0)) begin
+					$display("[!] Offset %0d : got %0d, expected 0", k, cap_i[i]);
+					errors = errors + 1;
+				end
+				if (cap_q[i] !== 0) begin
+					$display("[!] Q leak at offset %0d : %0d", k, cap_q[i]);
+					errors = errors + 1;
+				end
+			end
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_multipath_tb: PASS");
+		else
+			$display("[!] sig_multipath_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_multipath_tb
@@ -0,0 +1,141 @@
+/*
+ * sig_noise.v
+ *
+ * Additive white Gaussian noise injector for an I/Q stream
+ *
+ * Each rail has its own xorshift64 generator advanced once per valid
+ * sample. The 64 bits are summed as 8 signed bytes (central limit,
+ * tails up to 4.9 sigma), giving a zero mean value of standard deviation
+ * 209.0, which is then scaled by `level` / 2^12 and added to the input
+ * with saturation. The output noise standard deviation per rail is thus
+ * `level` * 0.05103 LSBs, `level` = 0 leaves the signal untouched.
+ *
+ * Latency is 1 clock cycle from input to output.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_noise #(
+	parameter integer WIDTH = 12,
+	parameter [63:0] SEED_I = 64'h2545f4914f6cdd1d,
+	parameter [63:0] SEED_Q = 64'h9e3779b97f4a7c15
+)(
+	// Input
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] in_data_i,
+	input  wire [WIDTH-1:0] in_data_q,
+
+	// Output
+	output wire [WIDTH-1:0] out_data_i,
+	output wire [WIDTH-1:0] out_data_q,
+	output wire [1:0] out_sat,
+
+	// Config
+	input  wire [15:0] level,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	wire [2*WIDTH-1:0] rail_in;
+	wire [2*WIDTH-1:0] rail_out;
+
+	// xorshift64 (13, 7, 17)
+	function [63:0] xs_next;
+		input [63:0] x;
+		reg [63:0] t;
+		begin
+			t = x ^ (x << 13);
+			t = t ^ (t >> 7);
+			xs_next = t ^ (t << 17);
+		end
+	endfunction
+
+
+	// Rails
+	// -----
+
+	assign rail_in = { in_data_q, in_data_i };
+
+	genvar r;
+
+	generate
+		for (r=0; r<2; r=r+1)
+		begin : rail
+			// Signals
+			reg  [63:0] state;
+			reg  signed [ 8:0] s1_0, s1_1, s1_2, s1_3;
+			reg  signed [ 9:0] s2_0, s2_1;
+			reg  signed [10:0] g_3;
+			reg  signed [27:0] m_4;
+			wire signed [16:0] n_4;
+			wire signed [17:0] y_sum;
+			reg  [WIDTH-1:0] data_out;
+			reg  data_sat;
+
+			// Generator
+			always @(posedge clk)
+			begin
+				if (rst)
+					state <= r ? SEED_Q : SEED_I;
+				else if (data_valid)
+					state <= xs_next(state);
+			end
+
+			// Sum of 8 signed bytes, each of mean -1/2
+			always @(posedge clk)
+			begin
+				s1_0 <= $signed(state[ 7: 0]) + $signed(state[15: 8]);
+				s1_1 <= $signed(state[23:16]) + $signed(state[31:24]);
+				s1_2 <= $signed(state[39:32]) + $signed(state[47:40]);
+				s1_3 <= $signed(state[55:48]) + $signed(state[63:56]);
+
+				s2_0 <= s1_0 + s1_1;
+				s2_1 <= s1_2 + s1_3;
+
+				g_3  <= s2_0 + s2_1 + 11'sd4;
+
+				m_4  <= g_3 * $signed({ 1'b0, level });
+			end
+
+			// Scale (rounded) and add
+			assign n_4   = (m_4 + 28'sd2048) >>> 12;
+			assign y_sum = $signed(rail_in[WIDTH*r+:WIDTH]) + n_4;
+
+			always @(posedge clk)
+			begin
+				if (rst) begin
+					data_out <= 0;
+					data_sat <= 1'b0;
+				end else begin
+					if (y_sum > $signed((1 << (WIDTH-1)) - 1))
+						data_out <= (1 << (WIDTH-1)) - 1;
+					else if (y_sum < -$signed(1 << (WIDTH-1)))
+						data_out <= 1 << (WIDTH-1);
+					else
+						data_out <= y_sum[WIDTH-1:0];
+
+					data_sat <= (y_sum > $signed((1 << (WIDTH-1)) - 1)) ||
+					            (y_sum < -$signed(1 << (WIDTH-1)));
+				end
+			end
+
+			assign rail_out[WIDTH*r+:WIDTH] = data_out;
+			assign out_sat[r] = data_sat;
+		end
+	endgenerate
+
+	assign out_data_i = rail_out[WIDTH-1:0];
+	assign out_data_q = rail_out[2*WIDTH-1:WIDTH];
+
+endmodule // sig_noise
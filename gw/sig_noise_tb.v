@@ -0,0 +1,178 @@
+/*
+ * sig_noise_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_noise_tb;
+
+	localparam integer N = 20000;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  valid_1;
+	reg  [11:0] in_data_i;
+	reg  [11:0] in_data_q;
+	reg  [11:0] in_data_i_1;
+	reg  [11:0] in_data_q_1;
+	wire [11:0] out_data_i;
+	wire [11:0] out_data_q;
+	wire [1:0] out_sat;
+	reg  [15:0] level;
+
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_noise_tb.vcd");
+		$dumpvars(0,sig_noise_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_noise #(
+		.WIDTH(12)
+	) dut_I (
+		.data_valid(data_valid),
+		.in_data_i(in_data_i),
+		.in_data_q(in_data_q),
+		.out_data_i(out_data_i),
+		.out_data_q(out_data_q),
+		.out_sat(out_sat),
+		.level(level),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Valid on one clock out of 2
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ~data_valid;
+
+	always @(posedge clk)
+	begin
+		valid_1     <= data_valid;
+		in_data_i_1 <= in_data_i;
+		in_data_q_1 <= in_data_q;
+	end
+
+	// Collect N output samples, returns the statistics of the added noise
+	real sum_i, sum_q, sum_ii, sum_qq, sum_iq;
+	integer n_sat;
+
+	task collect;
+		integer n;
+		real ni, nq;
+		begin
+			sum_i  = 0.0; sum_q  = 0.0;
+			sum_ii = 0.0; sum_qq = 0.0; sum_iq = 0.0;
+			n_sat  = 0;
+			n = 0;
+
+			while (n < N) begin
+				@(posedge clk);
+				#1;
+				if (valid_1) begin
+					ni = $itor($signed(out_data_i)) - $itor($signed(in_data_i_1));
+					nq = $itor($signed(out_data_q)) - $itor($signed(in_data_q_1));
+					sum_i  = sum_i  + ni;
+					sum_q  = sum_q  + nq;
+					sum_ii = sum_ii + ni * ni;
+					sum_qq = sum_qq + nq * nq;
+					sum_iq = sum_iq + ni * nq;
+					n_sat  = n_sat + (out_sat != 2'b00);
+					n = n + 1;
+				end
+			end
+		end
+	endtask
+
+	// Check the noise standard deviation for a level
+	task check_level;
+		input [15:0] lvl;
+		real mean_i, mean_q, sd_i, sd_q, corr, sd_exp;
+		begin
+			level = lvl;
+			in_data_i = 12'd0;
+			in_data_q = 12'd0;
+			repeat (16) @(posedge clk);
+
+			collect;
+
+			sd_exp = lvl * 209.0 / 4096.0;
+			mean_i = sum_i / N;
+			mean_q = sum_q / N;
+			sd_i = $sqrt(sum_ii / N - mean_i * mean_i);
+			sd_q = $sqrt(sum_qq / N - mean_q * mean_q);
+			corr = (sum_iq / N) / (sd_i * sd_q);
+
+			if ((mean_i > 0.1 * sd_exp) || (mean_i < -0.1 * sd_exp) ||
+			    (mean_q > 0.1 * sd_exp) || (mean_q < -0.1 * sd_exp) ||
+			    (sd_i < 0.95 * sd_exp) || (sd_i > 1.05 * sd_exp) ||
+			    (sd_q < 0.95 * sd_exp) || (sd_q > 1.05 * sd_exp) ||
+			    (corr > 0.05) || (corr < -0.05))
+			begin
+				$display("[!] Level %0d : mean %f / %f, sd %f / %f (expected %f), I/Q correlation %f",
+					lvl, mean_i, mean_q, sd_i, sd_q, sd_exp, corr);
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	initial begin
+		level = 0;
+		in_data_i = 12'd0;
+		in_data_q = 12'd0;
+		# 21 rst = 0;
+		# 100;
+
+		// Statistics
+		check_level(16'd4096);
+		check_level(16'd1000);
+
+		// Level 0 is transparent
+		level = 16'd0;
+		in_data_i = 12'd1234;
+		in_data_q = -12'd2048;
+		repeat (16) @(posedge clk);
+		collect;
+		if ((sum_ii != 0.0) || (sum_qq != 0.0) || (n_sat != 0)) begin
+			$display("[!] Level 0 changes the signal");
+			errors = errors + 1;
+		end
+
+		// Saturation near full scale
+		level = 16'd4096;
+		in_data_i = 12'd2000;
+		in_data_q = -12'd2000;
+		repeat (16) @(posedge clk);
+		collect;
+		if (n_sat == 0) begin
+			$display("[!] No saturation at full scale");
+			errors = errors + 1;
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_noise_tb: PASS");
+		else
+			$display("[!] sig_noise_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_noise_tb
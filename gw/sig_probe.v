@@ -0,0 +1,212 @@
+/*
+ * sig_probe.v
+ *
+ * Round trip latency probe
+ *
+ * On `start`, sends a 2^PN_LOG - 1 chips m-sequence (one chip per valid
+ * sample, +-AMP on I) on `probe_data_*` while `probe_active` is high, and
+ * correlates `rx_data_*` against it over the next 2^CNT_W samples. I and
+ * Q are correlated separately so the phase of the loop doesn't matter.
+ *
+ * `result_lat` is the number of samples between sending the first chip
+ * and receiving it, at the correlation peak. `result_peak` is the peak
+ * magnitude (|I| + |Q|, top 16 bits) to judge the quality of the result.
+ * Both are valid and stable once `done` is set.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_probe #(
+	parameter integer WIDTH  = 12,
+	parameter integer PN_LOG = 6,		// 5, 6 or 7
+	parameter integer CNT_W  = 16,
+	parameter integer AMP    = 1024
+)(
+	// Datapath
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] rx_data_i,
+	input  wire [WIDTH-1:0] rx_data_q,
+	output wire [WIDTH-1:0] probe_data_i,
+	output wire [WIDTH-1:0] probe_data_q,
+	output wire probe_active,
+
+	// Control / Result
+	input  wire start,
+	output reg  [CNT_W-1:0] result_lat,
+	output wire [15:0] result_peak,
+	output wire busy,
+	output reg  done,
+
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer L  = (1 << PN_LOG) - 1;
+	localparam integer AW = WIDTH + PN_LOG + 1;		// Correlation
+
+	// Second tap of a maximal length LFSR
+	localparam integer TAP = (PN_LOG == 5) ? 3 : (PN_LOG == 6) ? 5 : 6;
+
+	// Sequence, chip j is bit j
+	function [127:0] pn_seq;
+		input integer dummy;
+		reg [PN_LOG-1:0] s;
+		integer j;
+		begin
+			pn_seq = 0;
+			s = { PN_LOG{1'b1} };
+			for (j=0; j<L; j=j+1)
+			begin
+				pn_seq[j] = s[PN_LOG-1];
+				s = { s[PN_LOG-2:0], s[PN_LOG-1] ^ s[TAP-1] };
+			end
+		end
+	endfunction
+
+	localparam [127:0] PN = pn_seq(0);
+
+	localparam [1:0]
+		ST_IDLE   = 0,
+		ST_SEND   = 1,
+		ST_LISTEN = 2;
+
+	// Signals
+	// -------
+
+	// Control
+	reg  [1:0] state;
+	reg  [CNT_W-1:0] cnt;
+	reg  [PN_LOG-1:0] lfsr;
+
+	// Correlator (transposed form, h[k] = chip L-1-k)
+	wire signed [AW-1:0] x_i;
+	wire signed [AW-1:0] x_q;
+	reg  signed [AW-1:0] acc_i [1:L-1];
+	reg  signed [AW-1:0] acc_q [1:L-1];
+
+	reg  signed [AW-1:0] corr_i_1;
+	reg  signed [AW-1:0] corr_q_1;
+	reg  [CNT_W-1:0] cnt_1;
+	reg  act_1;
+
+	reg  [AW-1:0] mag_2;
+	reg  [CNT_W-1:0] cnt_2;
+	reg  act_2;
+
+	reg  [AW-1:0] peak;
+
+	integer k;
+
+
+	// Control
+	// -------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			state <= ST_IDLE;
+			cnt   <= 0;
+			lfsr  <= { PN_LOG{1'b1} };
+		end else if (start) begin
+			state <= ST_SEND;
+			cnt   <= 0;
+			lfsr  <= { PN_LOG{1'b1} };
+		end else if (data_valid) begin
+			case (state)
+				ST_SEND: begin
+					cnt  <= cnt + 1;
+					lfsr <= { lfsr[PN_LOG-2:0], lfsr[PN_LOG-1] ^ lfsr[TAP-1] };
+					if (cnt == L-1)
+						state <= ST_LISTEN;
+				end
+
+				ST_LISTEN: begin
+					cnt <= cnt + 1;
+					if (&cnt)
+						state <= ST_IDLE;
+				end
+
+				default: ;
+			endcase
+		end
+	end
+
+	assign probe_active = (state == ST_SEND);
+	assign probe_data_i = lfsr[PN_LOG-1] ? AMP : -AMP;
+	assign probe_data_q = 0;
+
+	assign busy = (state != ST_IDLE) | act_1 | act_2;
+
+
+	// Correlator
+	// ----------
+
+	assign x_i = { { (AW-WIDTH){rx_data_i[WIDTH-1]} }, rx_data_i };
+	assign x_q = { { (AW-WIDTH){rx_data_q[WIDTH-1]} }, rx_data_q };
+
+	always @(posedge clk)
+	begin
+		if (data_valid) begin
+			for (k=1; k<L-1; k=k+1)
+			begin
+				acc_i[k] <= acc_i[k+1] + (PN[L-1-k] ? x_i : -x_i);
+				acc_q[k] <= acc_q[k+1] + (PN[L-1-k] ? x_q : -x_q);
+			end
+
+			acc_i[L-1] <= PN[0] ? x_i : -x_i;
+			acc_q[L-1] <= PN[0] ? x_q : -x_q;
+
+			corr_i_1 <= acc_i[1] + (PN[L-1] ? x_i : -x_i);
+			corr_q_1 <= acc_q[1] + (PN[L-1] ? x_q : -x_q);
+		end
+	end
+
+	// Tag each correlation with the sample count
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			act_1 <= 1'b0;
+			act_2 <= 1'b0;
+		end else begin
+			act_1 <= data_valid & (state != ST_IDLE) & ~start;
+			act_2 <= act_1;
+		end
+
+		cnt_1 <= cnt;
+		cnt_2 <= cnt_1;
+
+		mag_2 <= (corr_i_1[AW-1] ? -corr_i_1 : corr_i_1) +
+		         (corr_q_1[AW-1] ? -corr_q_1 : corr_q_1);
+	end
+
+	// Peak search, only once a whole sequence could have been received
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			peak       <= 0;
+			result_lat <= 0;
+			done       <= 1'b0;
+		end else if (start) begin
+			peak       <= 0;
+			result_lat <= 0;
+			done       <= 1'b0;
+		end else if (act_2) begin
+			if ((cnt_2 >= L-1) && (mag_2 > peak)) begin
+				peak       <= mag_2;
+				result_lat <= cnt_2 - (L-1);
+			end
+
+			if (&cnt_2)
+				done <= 1'b1;
+		end
+	end
+
+	assign result_peak = peak[AW-1:AW-16];
+
+endmodule // sig_probe
@@ -0,0 +1,144 @@
+/*
+ * sig_probe_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_probe_tb;
+
+	localparam integer CNT_W = 10;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  start = 1'b0;
+	wire [11:0] probe_data_i;
+	wire [11:0] probe_data_q;
+	wire probe_active;
+	wire [11:0] rx_data_i;
+	wire [11:0] rx_data_q;
+
+	wire [CNT_W-1:0] result_lat;
+	wire [15:0] result_peak;
+	wire busy;
+	wire done;
+
+	// Loop model
+	reg  [11:0] loop_mem [0:255];
+	reg  [ 7:0] loop_ptr;
+	reg  [ 7:0] loop_lat;
+	wire [11:0] loop_data;
+	reg  [11:0] noise;
+
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_probe_tb.vcd");
+		$dumpvars(0,sig_probe_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_probe #(
+		.WIDTH(12),
+		.PN_LOG(6),
+		.CNT_W(CNT_W),
+		.AMP(1024)
+	) dut_I (
+		.data_valid(data_valid),
+		.rx_data_i(rx_data_i),
+		.rx_data_q(rx_data_q),
+		.probe_data_i(probe_data_i),
+		.probe_data_q(probe_data_q),
+		.probe_active(probe_active),
+		.start(start),
+		.result_lat(result_lat),
+		.result_peak(result_peak),
+		.busy(busy),
+		.done(done),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Valid on one clock out of 3
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ($random % 3) == 0;
+
+	// Loop : loop_lat samples, rotated by 90 degrees, halved, plus noise
+	always @(posedge clk)
+		if (rst)
+			loop_ptr <= 0;
+		else if (data_valid) begin
+			loop_mem[loop_ptr] <= probe_active ? probe_data_i : 12'd0;
+			loop_ptr <= loop_ptr + 1;
+			noise <= $random % 96;
+		end
+
+	assign loop_data = loop_mem[loop_ptr - loop_lat];
+
+	assign rx_data_i = noise;
+	assign rx_data_q = { loop_data[11], loop_data[11:1] } + noise;
+
+	integer n;
+
+	initial begin
+		for (n=0; n<256; n=n+1)
+			loop_mem[n] = 12'd0;
+		noise = 0;
+	end
+
+	// Run the probe for a given loop latency
+	task run;
+		input [7:0] lat;
+		begin
+			loop_lat = lat;
+
+			@(posedge clk);
+			start <= 1'b1;
+			@(posedge clk);
+			start <= 1'b0;
+
+			@(posedge done);
+			#1;
+
+			if (result_lat !== lat) begin
+				$display("[!] Latency %0d : measured %0d (peak %0d)", lat, result_lat, result_peak);
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	initial begin
+		loop_lat = 1;
+		# 21 rst = 0;
+		# 100;
+
+		run(1);
+		run(37);
+		run(200);
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_probe_tb: PASS");
+		else
+			$display("[!] sig_probe_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_probe_tb
@@ -0,0 +1,129 @@
+/*
+ * sig_ramp.v
+ *
+ * Delay ramp generator
+ *
+ * Moves a delay at a constant signed `rate` between the `lo` and `hi`
+ * bounds, to emulate a mobile moving at constant speed without any
+ * software involvement. The position is 16.32 fixed point, in samples,
+ * and advances by `rate` / 2^32 samples on each valid sample, so for a
+ * radial speed v (m/s), rate = 2^32 * v / c.
+ *
+ * On `load`, or while disabled, the position is set back to `start` (in
+ * samples, 16.16) and the ramp goes in the direction of the rate. When it
+ * reaches the bound it's heading to, it stops there, or in ping-pong mode
+ * turns around and goes back to the other one. |rate| must stay below
+ * 2^31 (half a sample per sample).
+ *
+ * The integer part drives a delay line and the fractional part a
+ * fractional delay filter. The fractional output lags by LAG valid
+ * samples, the latency of the delay line plus the filter history up to
+ * its interpolation point, so both parts step on the same sample. Both
+ * must count in valid samples (see sig_delay_iq) for that to hold with
+ * any `data_valid` pattern. Going down, the sample the delay line skips
+ * on an integer step is missing from the filter history, so that one
+ * output is off by up to a sample.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_ramp #(
+	parameter integer LAG = 6
+)(
+	// Timing
+	input  wire data_valid,
+	input  wire load,
+
+	// Config
+	input  wire enable,
+	input  wire pingpong,
+	input  wire [31:0] start,
+	input  wire [31:0] rate,
+	input  wire [15:0] lo,
+	input  wire [15:0] hi,
+
+	// Current delay
+	output wire [15:0] delay,
+	output wire [15:0] frac,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	reg  [47:0] pos;
+	reg  dir;
+
+	wire [31:0] step;
+	wire [48:0] nxt;
+	wire [48:0] bound_hi;
+	wire [48:0] bound_lo;
+	wire hit_hi;
+	wire hit_lo;
+
+	reg  [15:0] frac_dly [0:LAG-1];
+
+	integer k;
+
+
+	// Position
+	// --------
+
+	// Going back after a turn around is the negated rate
+	assign step = dir ? -rate : rate;
+
+	// One extra bit so the bounds compare can't wrap, nxt[48] set going
+	// up means past 0xffff, going down means below 0
+	assign nxt = { 1'b0, pos } + { { 17{step[31]} }, step };
+
+	assign bound_hi = { 1'b0, hi, 32'd0 };
+	assign bound_lo = { 1'b0, lo, 32'd0 };
+
+	assign hit_hi = ~step[31] & (nxt >= bound_hi);
+	assign hit_lo =  step[31] & ( nxt[48] | (nxt <= bound_lo));
+
+	always @(posedge clk)
+	begin
+		if (rst | load | ~enable) begin
+			pos <= { start, 16'd0 };
+			dir <= 1'b0;
+		end else if (data_valid) begin
+			if (hit_hi) begin
+				pos <= bound_hi[47:0];
+				dir <= dir ^ pingpong;
+			end else if (hit_lo) begin
+				pos <= bound_lo[47:0];
+				dir <= dir ^ pingpong;
+			end else begin
+				pos <= nxt[47:0];
+			end
+		end
+	end
+
+
+	// Outputs
+	// -------
+
+	assign delay = pos[47:32];
+
+	always @(posedge clk)
+	begin
+		if (data_valid) begin
+			frac_dly[0] <= pos[31:16];
+			for (k=1; k<LAG; k=k+1)
+				frac_dly[k] <= frac_dly[k-1];
+		end
+	end
+
+	assign frac = frac_dly[LAG-1];
+
+endmodule // sig_ramp
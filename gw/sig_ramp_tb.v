@@ -0,0 +1,293 @@
+/*
+ * sig_ramp_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_ramp_tb;
+
+	localparam integer LAG = 6;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  load;
+	reg  enable;
+	reg  pingpong;
+	reg  [31:0] start;
+	reg  [31:0] rate;
+	reg  [15:0] lo;
+	reg  [15:0] hi;
+	wire [15:0] delay;
+	wire [15:0] frac;
+
+	reg  [1:0] valid_mode;
+	reg  [11:0] tag;
+	wire [11:0] line_out;
+	wire [11:0] frac_out;
+
+	integer n_valid = 0;
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_ramp_tb.vcd");
+		$dumpvars(0,sig_ramp_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_ramp #(
+		.LAG(LAG)
+	) dut_I (
+		.data_valid(data_valid),
+		.load(load),
+		.enable(enable),
+		.pingpong(pingpong),
+		.start(start),
+		.rate(rate),
+		.lo(lo),
+		.hi(hi),
+		.delay(delay),
+		.frac(frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Delay line and fractional delay filter, as in rfloop
+	sig_delay_iq #(
+		.WIDTH(12),
+		.DEPTH(3072)
+	) line_I (
+		.data_valid(data_valid),
+		.data_in_i(tag),
+		.data_in_q(12'h000),
+		.data_out_i(line_out),
+		.data_out_q(),
+		.delay(delay - 16'd10),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_farrow #(
+		.WIDTH(12)
+	) farrow_I (
+		.data_valid(data_valid),
+		.data_in(line_out),
+		.data_out(frac_out),
+		.data_sat(),
+		.frac(frac),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Valid on one clock out of 2, back to back, or random
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else case (valid_mode)
+			2'd0:    data_valid <= ~data_valid;
+			2'd1:    data_valid <= 1'b1;
+			default: data_valid <= ($random & 3) != 0;
+		endcase
+
+	// Position LAG valid samples ago, and samples tagged with their index
+	reg  [47:0] pos_hist [0:LAG];
+	integer k;
+
+	always @(posedge clk)
+		if (rst)
+			tag <= 0;
+		else if (data_valid) begin
+			tag <= tag + 1;
+			n_valid <= n_valid + 1;
+			pos_hist[0] <= dut_I.pos;
+			for (k=1; k<=LAG; k=k+1)
+				pos_hist[k] <= pos_hist[k-1];
+		end
+
+	// The filter interpolates from the sample 5 valid samples behind the
+	// input (2 in the line, 3 in its history), which went through
+	// delay - 10 in the line : that delay and the fractional part it's
+	// interpolated with must come from the same position, once the line
+	// holds samples
+	wire [11:0] line_used;
+	assign line_used = tag - 12'd5 - farrow_I.x1 + 12'd10;
+
+	always @(posedge clk)
+		if (!rst && data_valid && (n_valid > 256)) begin
+			if (line_used !== pos_hist[LAG-1][43:32]) begin
+				if (errors < 10)
+					$display("[!] Filter at %0d.%04x, line at %0d", pos_hist[LAG-1][47:32], frac, line_used);
+				errors = errors + 1;
+			end
+		end
+
+	// Track the delay extremes and the turn arounds
+	reg  [15:0] d_min, d_max, d_prev;
+	reg  going_up;
+	integer n_turns, n_checked;
+
+	task track_reset;
+		begin
+			d_min = 16'hffff;
+			d_max = 16'h0000;
+			d_prev = start[31:16];
+			going_up = 1'b1;
+			n_turns = 0;
+			n_checked = 0;
+		end
+	endtask
+
+	always @(posedge clk)
+	begin
+		#1;
+		if (!rst && enable && !load) begin
+			if (delay < d_min) d_min = delay;
+			if (delay > d_max) d_max = delay;
+
+			if (going_up && (delay < d_prev)) begin
+				going_up = 1'b0;
+				n_turns = n_turns + 1;
+			end else if (!going_up && (delay > d_prev)) begin
+				going_up = 1'b1;
+				n_turns = n_turns + 1;
+			end
+
+			// Never more than one sample per step at these rates
+			if ((delay > d_prev + 1) || (delay + 1 < d_prev)) begin
+				$display("[!] Delay jump %0d -> %0d", d_prev, delay);
+				errors = errors + 1;
+			end
+
+			if (pos_hist[LAG-1][31:16] !== frac) begin
+				if (n_checked > LAG) begin
+					$display("[!] Frac %04x, expected %04x", frac, pos_hist[LAG-1][31:16]);
+					errors = errors + 1;
+				end
+			end
+
+			n_checked = n_checked + 1;
+			d_prev = delay;
+		end
+	end
+
+	task restart;
+		begin
+			@(posedge clk);
+			load <= 1'b1;
+			@(posedge clk);
+			load <= 1'b0;
+			track_reset;
+		end
+	endtask
+
+	initial begin
+		valid_mode = 2'd0;
+		load = 1'b0;
+		enable = 1'b0;
+		pingpong = 1'b0;
+		start = { 16'd100, 16'h8000 };
+		rate = 32'h40000000;		// 1/4 sample per sample
+		lo = 16'd90;
+		hi = 16'd110;
+
+		# 21 rst = 0;
+		enable = 1'b1;
+
+		// Stop mode, going up : 38 valid samples to the upper bound
+		restart;
+		repeat (2 * 200) @(posedge clk);
+
+		if ((delay !== 16'd110) || (frac !== 16'h0000) || (d_min !== 16'd100) || (n_turns != 0)) begin
+			$display("[!] Stop up : at %0d.%04x, min %0d, %0d turns", delay, frac, d_min, n_turns);
+			errors = errors + 1;
+		end
+
+		// Stop mode, going down
+		rate = -32'h40000000;
+		restart;
+		repeat (2 * 200) @(posedge clk);
+
+		if ((delay !== 16'd90) || (d_max !== 16'd100)) begin
+			$display("[!] Stop down : at %0d.%04x, max %0d", delay, frac, d_max);
+			errors = errors + 1;
+		end
+
+		// Ping-pong : 80 valid samples from one bound to the other
+		rate = 32'h40000000;
+		pingpong = 1'b1;
+		restart;
+		repeat (2 * 1620) @(posedge clk);
+
+		if ((d_min !== 16'd90) || (d_max !== 16'd110) || (n_turns < 19) || (n_turns > 21)) begin
+			$display("[!] Ping-pong : %0d - %0d, %0d turns", d_min, d_max, n_turns);
+			errors = errors + 1;
+		end
+
+		// Slow ramp, with a rate that doesn't divide a sample
+		rate = 32'h00123457;
+		pingpong = 1'b0;
+		restart;
+		repeat (2 * 5000) @(posedge clk);
+
+		if ((delay !== 16'd101) || (n_turns != 0)) begin
+			$display("[!] Slow ramp : at %0d.%04x", delay, frac);
+			errors = errors + 1;
+		end
+
+		// Ping-pong again with back to back valid samples, the delay line
+		// must keep up with the fractional part
+		valid_mode = 2'd1;
+		rate = 32'h40000000;
+		pingpong = 1'b1;
+		restart;
+		repeat (1620) @(posedge clk);
+
+		if ((d_min !== 16'd90) || (d_max !== 16'd110) || (n_turns < 19) || (n_turns > 21)) begin
+			$display("[!] Back to back : %0d - %0d, %0d turns", d_min, d_max, n_turns);
+			errors = errors + 1;
+		end
+
+		// And with random gaps
+		valid_mode = 2'd2;
+		rate = 32'h0b000000;
+		restart;
+		repeat (5000) @(posedge clk);
+
+		if ((d_min !== 16'd90) || (d_max !== 16'd110) || (n_turns < 5)) begin
+			$display("[!] Random valid : %0d - %0d, %0d turns", d_min, d_max, n_turns);
+			errors = errors + 1;
+		end
+
+		// Disabled : back to the start
+		valid_mode = 2'd0;
+		enable = 1'b0;
+		repeat (2 * 10) @(posedge clk);
+
+		if ((delay !== 16'd100) || (dut_I.pos[31:16] !== 16'h8000)) begin
+			$display("[!] Disabled : at %0d.%04x", delay, dut_I.pos[31:16]);
+			errors = errors + 1;
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_ramp_tb: PASS");
+		else
+			$display("[!] sig_ramp_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_ramp_tb
@@ -0,0 +1,212 @@
+/*
+ * sig_rotate.v
+ *
+ * Frequency shift / phase rotation of an I/Q stream
+ *
+ * Multiplies the samples by exp(j * phi) where phi is a phase accumulator
+ * NCO advancing by `freq` (turns * 2^32) for each valid sample, plus a
+ * constant `phase` offset (turns * 2^16). The complex multiply runs on
+ * four `sig_combine` (two cascaded per rail) so it keeps up with the full
+ * sample rate. Combined with a real scale downstream this gives a complex
+ * gain with Doppler.
+ *
+ * Total latency is 7 clock cycles. |output| can reach sqrt(2) * |input|,
+ * the output saturates.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_rotate #(
+	parameter integer D_WIDTH   = 12,
+	parameter integer PHASE_LOG = 10
+)(
+	// Input
+	input  wire data_valid,
+	input  wire [D_WIDTH-1:0] in_data_i,
+	input  wire [D_WIDTH-1:0] in_data_q,
+
+	// Output
+	output wire [D_WIDTH-1:0] out_data_i,
+	output wire [D_WIDTH-1:0] out_data_q,
+	output wire [1:0] out_sat,
+
+	// Config
+	input  wire [31:0] freq,
+	input  wire [15:0] phase,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	// NCO
+	reg  [31:0] nco_acc;
+	reg  [PHASE_LOG-1:0] nco_addr_1;
+	reg  [31:0] nco_rom [0:(1<<PHASE_LOG)-1];
+	reg  [31:0] nco_data_2;
+	wire [15:0] nco_cos_2;
+	wire [15:0] nco_sin_2;
+	reg  [15:0] nco_cos_3;
+	reg  [15:0] nco_sin_3;
+	reg  [15:0] nco_nsin_3;
+
+	// Data (aligned with the NCO)
+	reg  [D_WIDTH-1:0] data_i_1, data_i_2, data_i_3, data_i_4;
+	reg  [D_WIDTH-1:0] data_q_1, data_q_2, data_q_3, data_q_4;
+	reg  [15:0] nco_cos_4;
+	reg  [15:0] nco_sin_4;
+	reg  [15:0] nco_nsin_4;
+
+	// Cascades
+	wire [47:0] pc_i;
+	wire [47:0] pc_q;
+
+
+	// NCO
+	// ---
+
+	always @(posedge clk)
+	begin
+		if (rst)
+			nco_acc <= 32'h00000000;
+		else if (data_valid)
+			nco_acc <= nco_acc + freq;
+	end
+
+	always @(posedge clk)
+		nco_addr_1 <= nco_acc[31:32-PHASE_LOG] + phase[15:16-PHASE_LOG];
+
+	always @(posedge clk)
+		nco_data_2 <= nco_rom[nco_addr_1];
+
+	assign nco_cos_2 = nco_data_2[15: 0];
+	assign nco_sin_2 = nco_data_2[31:16];
+
+	always @(posedge clk)
+	begin
+		nco_cos_3  <= nco_cos_2;
+		nco_sin_3  <= nco_sin_2;
+		nco_nsin_3 <= -nco_sin_2;
+	end
+
+	// cos / sin table, Q2.14
+	function integer round;
+		input real v;
+		round = (v >= 0.0) ? $rtoi(v + 0.5) : -$rtoi(0.5 - v);
+	endfunction
+
+	integer n;
+	real w;
+
+	initial
+		for (n=0; n<(1<<PHASE_LOG); n=n+1)
+		begin
+			w = 6.283185307179586 * n / (1 << PHASE_LOG);
+			nco_rom[n][15: 0] = round(16384.0 * $cos(w));
+			nco_rom[n][31:16] = round(16384.0 * $sin(w));
+		end
+
+
+	// Data
+	// ----
+
+	always @(posedge clk)
+	begin
+		data_i_1 <= in_data_i;
+		data_i_2 <= data_i_1;
+		data_i_3 <= data_i_2;
+		data_i_4 <= data_i_3;
+		data_q_1 <= in_data_q;
+		data_q_2 <= data_q_1;
+		data_q_3 <= data_q_2;
+		data_q_4 <= data_q_3;
+
+		nco_cos_4  <= nco_cos_3;
+		nco_sin_4  <= nco_sin_3;
+		nco_nsin_4 <= nco_nsin_3;
+	end
+
+
+	// Complex multiply
+	// ----------------
+
+	// I = i * cos - q * sin
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("DIRECT")
+	) mult_ii_I (
+		.in_data_0(data_i_3),
+		.in_scale_0(nco_cos_3),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(48'h000000000000),
+		.out_3(),
+		.out_sat_3(),
+		.out_pcout_3(pc_i),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("CASCADE")
+	) mult_qi_I (
+		.in_data_0(data_q_4),
+		.in_scale_0(nco_nsin_4),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(pc_i),
+		.out_3(out_data_i),
+		.out_sat_3(out_sat[0]),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Q = q * cos + i * sin
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("DIRECT")
+	) mult_qq_I (
+		.in_data_0(data_q_3),
+		.in_scale_0(nco_cos_3),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(48'h000000000000),
+		.out_3(),
+		.out_sat_3(),
+		.out_pcout_3(pc_q),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_combine #(
+		.D_WIDTH(D_WIDTH),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("CASCADE")
+	) mult_iq_I (
+		.in_data_0(data_i_4),
+		.in_scale_0(nco_sin_4),
+		.in_chain_0({D_WIDTH{1'b0}}),
+		.in_pcin_2(pc_q),
+		.out_3(out_data_q),
+		.out_sat_3(out_sat[1]),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+endmodule // sig_rotate
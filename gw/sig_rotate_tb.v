@@ -0,0 +1,137 @@
+/*
+ * sig_rotate_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_rotate_tb;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  [1:0] data_cnt;
+	wire data_valid;
+	wire [11:0] data_out_i;
+	wire [11:0] data_out_q;
+
+	reg  [31:0] cfg_freq;
+	reg  [15:0] cfg_phase;
+
+	integer errors = 0;
+	integer n;
+	real a_prev, a, d, m;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_rotate_tb.vcd");
+		$dumpvars(0,sig_rotate_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_rotate #(
+		.D_WIDTH(12),
+		.PHASE_LOG(10)
+	) dut_I (
+		.data_valid(data_valid),
+		.in_data_i(12'd1000),
+		.in_data_q(12'd0),
+		.out_data_i(data_out_i),
+		.out_data_q(data_out_q),
+		.out_sat(),
+		.freq(cfg_freq),
+		.phase(cfg_phase),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// One sample every 4 cycles
+	always @(posedge clk)
+		if (rst)
+			data_cnt <= 0;
+		else
+			data_cnt <= data_cnt + 1;
+
+	assign data_valid = (data_cnt == 2'd3);
+
+	// Helpers
+	task sample;
+		output real angle;
+		output real mag;
+		real i, q;
+		begin
+			@(posedge clk);
+			while (!data_valid)
+				@(posedge clk);
+			i = $signed(data_out_i);
+			q = $signed(data_out_q);
+			angle = $atan2(q, i) * 180.0 / 3.141592653589793;
+			mag = $sqrt(i*i + q*q);
+		end
+	endtask
+
+	task check;
+		input [8*32-1:0] what;
+		input real got;
+		input real expected;
+		input real tol;
+		begin
+			if ((got < expected - tol) || (got > expected + tol)) begin
+				$display("[!] %0s : got %f, expected %f", what, got, expected);
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	// Scenario
+	initial begin
+		// Static phase offset of 90 degrees
+		cfg_freq  = 32'h00000000;
+		cfg_phase = 16'h4000;
+
+		# 21 rst = 0;
+		repeat (20) @(posedge clk);
+
+		sample(a, m);
+		check("Phase offset", a, 90.0, 0.5);
+		check("Magnitude", m, 1000.0, 2.0);
+
+		// Frequency shift of -1/64 turn per sample
+		cfg_freq  = 32'hfc000000;
+		cfg_phase = 16'h0000;
+		repeat (20) @(posedge clk);
+
+		sample(a_prev, m);
+		for (n=0; n<200; n=n+1)
+		begin
+			sample(a, m);
+			d = a - a_prev;
+			if (d > 180.0)
+				d = d - 360.0;
+			if (d < -180.0)
+				d = d + 360.0;
+			check("Phase step", d, -5.625, 0.5);
+			check("Magnitude", m, 1000.0, 2.0);
+			a_prev = a;
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_rotate_tb: PASS");
+		else
+			$display("[!] sig_rotate_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_rotate_tb
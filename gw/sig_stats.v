@@ -0,0 +1,178 @@
+/*
+ * sig_stats.v
+ *
+ * Datapath telemetry : peak and average power of the RX and TX rails,
+ * valid samples and saturation events counts.
+ *
+ * Everything is computed over windows of 2^WIN_LOG valid samples and
+ * latched at the end of each window into `stat_regs`, which then stay
+ * stable for a whole window. `stat_update` toggles each time, so the
+ * registers can be sampled from another clock domain.
+ *
+ *  stat_regs[ 0] : Valid samples count (wraps)
+ *  stat_regs[ 1] : Samples with saturation count (wraps)
+ *  stat_regs[ 2] : RX peak |x|, [15:0] I, [31:16] Q
+ *  stat_regs[ 3] : RX I mean power (x^2)
+ *  stat_regs[ 4] : RX Q mean power
+ *  stat_regs[ 5] : TX peak |x|, [15:0] I, [31:16] Q
+ *  stat_regs[ 6] : TX I mean power
+ *  stat_regs[ 7] : TX Q mean power
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_stats #(
+	parameter integer WIDTH   = 12,
+	parameter integer N_SAT   = 1,
+	parameter integer WIN_LOG = 20
+)(
+	// Datapath
+	input  wire data_valid,
+	input  wire [WIDTH-1:0] rx_data_i,
+	input  wire [WIDTH-1:0] rx_data_q,
+	input  wire [WIDTH-1:0] tx_data_i,
+	input  wire [WIDTH-1:0] tx_data_q,
+	input  wire [N_SAT-1:0] sat,
+
+	// Results
+	output reg  [8*32-1:0] stat_regs,
+	output reg  stat_update,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	localparam integer PW = 2 * WIDTH;		// x^2
+	localparam integer AW = PW + WIN_LOG;	// Sum of x^2
+
+	// Signals
+	// -------
+
+	// Window
+	reg  [WIN_LOG-1:0] win_cnt;
+	reg  win_end_1;
+	reg  win_end_2;
+	reg  valid_1;
+
+	// Counters
+	reg  [31:0] cnt_valid;
+	reg  [31:0] cnt_sat;
+	reg  sat_1;
+
+	// Rails (RX I, RX Q, TX I, TX Q)
+	wire [4*WIDTH-1:0] rail_data;
+	wire [4*WIDTH-1:0] rail_peak;
+	wire [4*AW-1:0] rail_acc;
+
+
+	// Window & counters
+	// -----------------
+
+	always @(posedge clk)
+	begin
+		if (rst)
+			win_cnt <= 0;
+		else if (data_valid)
+			win_cnt <= win_cnt + 1;
+	end
+
+	// Pipeline for the rails
+	always @(posedge clk)
+	begin
+		valid_1   <= data_valid & ~rst;
+		sat_1     <= |sat;
+		win_end_1 <= data_valid & (&win_cnt);
+		win_end_2 <= win_end_1;
+	end
+
+	// Counters, on the rails pipeline so the snapshot taken at the window
+	// end holds exactly the samples of the window
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			cnt_valid <= 0;
+			cnt_sat   <= 0;
+		end else if (valid_1) begin
+			cnt_valid <= cnt_valid + 1;
+			cnt_sat   <= cnt_sat + sat_1;
+		end
+	end
+
+
+	// Rails
+	// -----
+
+	assign rail_data = { tx_data_q, tx_data_i, rx_data_q, rx_data_i };
+
+	genvar r;
+
+	generate
+		for (r=0; r<4; r=r+1)
+		begin : rail
+			// Signals
+			wire signed [WIDTH-1:0] x_0;
+			reg  [WIDTH-1:0] abs_1;
+			reg  [PW-1:0] sq_1;
+			reg  [WIDTH-1:0] peak;
+			reg  [AW-1:0] acc;
+
+			assign x_0 = rail_data[WIDTH*r+:WIDTH];
+
+			// |x| and x^2
+			always @(posedge clk)
+			begin
+				abs_1 <= x_0[WIDTH-1] ? -x_0 : x_0;
+				sq_1  <= x_0 * x_0;
+			end
+
+			// Accumulate, restart with each window
+			always @(posedge clk)
+			begin
+				if (rst) begin
+					peak <= 0;
+					acc  <= 0;
+				end else if (win_end_2) begin
+					peak <= valid_1 ? abs_1 : 0;
+					acc  <= valid_1 ? sq_1  : 0;
+				end else if (valid_1) begin
+					if (abs_1 > peak)
+						peak <= abs_1;
+					acc <= acc + sq_1;
+				end
+			end
+
+			assign rail_peak[WIDTH*r+:WIDTH] = peak;
+			assign rail_acc[AW*r+:AW] = acc;
+		end
+	endgenerate
+
+
+	// Results
+	// -------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			stat_regs   <= 0;
+			stat_update <= 1'b0;
+		end else if (win_end_2) begin
+			stat_regs[  0+:32] <= cnt_valid;
+			stat_regs[ 32+:32] <= cnt_sat;
+			stat_regs[ 64+:32] <= { { (16-WIDTH){1'b0} }, rail_peak[WIDTH+:WIDTH], { (16-WIDTH){1'b0} }, rail_peak[0+:WIDTH] };
+			stat_regs[ 96+:32] <= rail_acc[0*AW+WIN_LOG+:PW];
+			stat_regs[128+:32] <= rail_acc[1*AW+WIN_LOG+:PW];
+			stat_regs[160+:32] <= { { (16-WIDTH){1'b0} }, rail_peak[3*WIDTH+:WIDTH], { (16-WIDTH){1'b0} }, rail_peak[2*WIDTH+:WIDTH] };
+			stat_regs[192+:32] <= rail_acc[2*AW+WIN_LOG+:PW];
+			stat_regs[224+:32] <= rail_acc[3*AW+WIN_LOG+:PW];
+			stat_update <= ~stat_update;
+		end
+	end
+
+endmodule // sig_stats
@@ -0,0 +1,135 @@
+/*
+ * sig_stats_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_stats_tb;
+
+	localparam integer WIN_LOG = 8;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  [11:0] rx_data_i;
+	wire [11:0] rx_data_q;
+	wire [11:0] tx_data_i;
+	wire [11:0] tx_data_q;
+	reg  [1:0] sat_cnt;
+	wire [1:0] sat;
+
+	wire [8*32-1:0] stat_regs;
+	wire stat_update;
+
+	reg  [31:0] prev_valid;
+	integer errors = 0;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_stats_tb.vcd");
+		$dumpvars(0,sig_stats_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_stats #(
+		.WIDTH(12),
+		.N_SAT(2),
+		.WIN_LOG(WIN_LOG)
+	) dut_I (
+		.data_valid(data_valid),
+		.rx_data_i(rx_data_i),
+		.rx_data_q(rx_data_q),
+		.tx_data_i(tx_data_i),
+		.tx_data_q(tx_data_q),
+		.sat(sat),
+		.stat_regs(stat_regs),
+		.stat_update(stat_update),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	// Data gen : RX I +-1000, RX Q 500, TX I full scale negative, TX Q 0
+	always @(posedge clk)
+		if (rst)
+			rx_data_i <= 12'd1000;
+		else if (data_valid)
+			rx_data_i <= -rx_data_i;
+
+	assign rx_data_q = 12'd500;
+	assign tx_data_i = 12'h800;
+	assign tx_data_q = 12'd0;
+
+	// Saturation on one sample out of 4
+	always @(posedge clk)
+		if (rst)
+			sat_cnt <= 0;
+		else if (data_valid)
+			sat_cnt <= sat_cnt + 1;
+
+	assign sat = { 1'b0, sat_cnt == 2'd0 };
+
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ($random & 3) == 0;
+
+	// Checks
+	task check;
+		input [8*32-1:0] what;
+		input [31:0] got;
+		input [31:0] expected;
+		begin
+			if (got !== expected) begin
+				$display("[!] %0s : got %0d, expected %0d", what, got, expected);
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	initial begin
+		# 21 rst = 0;
+
+		// Skip the first window
+		@(stat_update);
+		prev_valid = stat_regs[0+:32];
+
+		repeat (3)
+		begin
+			@(stat_update);
+			#1;
+
+			check("Valid count", stat_regs[0+:32] - prev_valid, 1 << WIN_LOG);
+			check("Saturation count", stat_regs[32+:32], (stat_regs[0+:32] + 3) / 4);
+			check("RX peak", stat_regs[ 64+:32], (500 << 16) | 1000);
+			check("RX I power", stat_regs[ 96+:32], 1000 * 1000);
+			check("RX Q power", stat_regs[128+:32], 500 * 500);
+			check("TX peak", stat_regs[160+:32], 2048);
+			check("TX I power", stat_regs[192+:32], 2048 * 2048);
+			check("TX Q power", stat_regs[224+:32], 0);
+
+			prev_valid = stat_regs[0+:32];
+		end
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_stats_tb: PASS");
+		else
+			$display("[!] sig_stats_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_stats_tb
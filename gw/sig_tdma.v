@@ -0,0 +1,85 @@
+/*
+ * sig_tdma.v
+ *
+ * TDMA slot sequencer
+ *
+ * Follows a TDMA frame of 2^SLOT_LOG equal slots and outputs the entry
+ * of `slot_table` for the current slot, switched on the slot boundaries.
+ *
+ * The frame position is a 32 bits phase accumulator advanced by `step`
+ * on each valid sample, a full turn being one frame. The slot number is
+ * the top SLOT_LOG bits of that phase plus `offset`, which shifts the
+ * frame timing to align it with the received one. For GSM (8 slots of
+ * 15/26 ms), step = 2^32 * 13 / (60e-3 * sample rate). A fractional
+ * number of samples per slot is fine, the slot boundaries are placed
+ * on the closest sample.
+ *
+ * The outputs are registered and only change on a slot boundary or when
+ * the table itself changes, so each slot sees a single entry.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_tdma #(
+	parameter integer SLOT_LOG = 3,
+	parameter integer E_WIDTH  = 32
+)(
+	// Timing
+	input  wire data_valid,
+	input  wire [31:0] step,
+	input  wire [31:0] offset,
+
+	// Table
+	input  wire [(E_WIDTH << SLOT_LOG)-1:0] slot_table,
+
+	// Current slot
+	output reg  [SLOT_LOG-1:0] slot,
+	output reg  [E_WIDTH-1:0] slot_entry,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	reg  [31:0] phase;
+	wire [31:0] pos;
+
+
+	// Frame timing
+	// ------------
+
+	always @(posedge clk)
+	begin
+		if (rst)
+			phase <= 32'd0;
+		else if (data_valid)
+			phase <= phase + step;
+	end
+
+	assign pos = phase + offset;
+
+
+	// Table lookup
+	// ------------
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			slot       <= 0;
+			slot_entry <= 0;
+		end else begin
+			slot       <= pos[31:32-SLOT_LOG];
+			slot_entry <= slot_table[E_WIDTH*pos[31:32-SLOT_LOG]+:E_WIDTH];
+		end
+	end
+
+endmodule // sig_tdma
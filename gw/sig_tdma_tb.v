@@ -0,0 +1,353 @@
+/*
+ * sig_tdma_tb.v
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+`timescale 1ns/1ps
+
+module sig_tdma_tb;
+
+	// 1000 samples frames, 125 samples slots
+	localparam [31:0] STEP = 32'd4294967;
+
+	// Signals
+	reg rst = 1;
+	reg clk = 0;
+
+	reg  data_valid;
+	reg  [31:0] offset;
+	reg  [8*32-1:0] slot_table;
+	wire [2:0] slot;
+	wire [31:0] slot_entry;
+
+	integer errors = 0;
+
+	// RF loopback
+	reg  [11:0] rx_data_i;
+	reg  [11:0] rx_data_q;
+	wire [11:0] out_data_i;
+	wire [11:0] out_data_q;
+
+	reg         up_wreq;
+	reg  [13:0] up_waddr;
+	reg  [31:0] up_wdata;
+
+	// Setup recording
+`ifdef DUMP
+	initial begin
+		$dumpfile("sig_tdma_tb.vcd");
+		$dumpvars(0,sig_tdma_tb);
+	end
+`endif
+
+	// Clock
+	always #5 clk = !clk;
+
+	// DUT
+	sig_tdma #(
+		.SLOT_LOG(3),
+		.E_WIDTH(32)
+	) dut_I (
+		.data_valid(data_valid),
+		.step(STEP),
+		.offset(offset),
+		.slot_table(slot_table),
+		.slot(slot),
+		.slot_entry(slot_entry),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	rfloop #(
+		.PAIR_ID(0),
+		.N_TAPS(2),
+		.TAP_LOG(8)
+	) loop_I (
+		.data_valid(data_valid),
+		.rx_data_i(rx_data_i),
+		.rx_data_q(rx_data_q),
+		.tx_data_i(12'd0),
+		.tx_data_q(12'd0),
+		.dly_data_i(),
+		.dly_data_q(),
+		.out_data_i(out_data_i),
+		.out_data_q(out_data_q),
+		.m_axi_awaddr(),
+		.m_axi_awlen(),
+		.m_axi_awsize(),
+		.m_axi_awburst(),
+		.m_axi_awcache(),
+		.m_axi_awprot(),
+		.m_axi_awvalid(),
+		.m_axi_awready(1'b0),
+		.m_axi_wdata(),
+		.m_axi_wstrb(),
+		.m_axi_wlast(),
+		.m_axi_wvalid(),
+		.m_axi_wready(1'b0),
+		.m_axi_bresp(2'b00),
+		.m_axi_bvalid(1'b0),
+		.m_axi_bready(),
+		.m_axi_araddr(),
+		.m_axi_arlen(),
+		.m_axi_arsize(),
+		.m_axi_arburst(),
+		.m_axi_arcache(),
+		.m_axi_arprot(),
+		.m_axi_arvalid(),
+		.m_axi_arready(1'b0),
+		.m_axi_rdata(64'd0),
+		.m_axi_rresp(2'b00),
+		.m_axi_rlast(1'b0),
+		.m_axi_rvalid(1'b0),
+		.m_axi_rready(),
+		.clk(clk),
+		.rst(rst),
+		.up_rstn(~rst),
+		.up_clk(clk),
+		.up_wreq(up_wreq),
+		.up_waddr(up_waddr),
+		.up_wdata(up_wdata),
+		.up_wack(),
+		.up_rreq(1'b0),
+		.up_raddr(14'd0),
+		.up_rdata(),
+		.up_rack()
+	);
+
+	// Valid on one clock out of 2
+	always @(posedge clk)
+		if (rst)
+			data_valid <= 1'b0;
+		else
+			data_valid <= ~data_valid;
+
+	// Check the slot sequence and count the samples in each slot
+	reg  [2:0] slot_prev;
+	integer run, n_runs, n_short;
+	reg  valid_1;
+
+	always @(posedge clk)
+		valid_1 <= data_valid;
+
+	always @(posedge clk)
+	begin
+		#1;
+		if (rst) begin
+			slot_prev = 0;
+			run = 0;
+			n_runs = 0;
+			n_short = 0;
+		end else begin
+			if (slot_entry !== slot_table[32*slot+:32]) begin
+				$display("[!] Slot %0d : entry %08x", slot, slot_entry);
+				errors = errors + 1;
+			end
+
+			if (slot != slot_prev) begin
+				if (slot != (slot_prev + 3'd1)) begin
+					$display("[!] Slot %0d after slot %0d", slot, slot_prev);
+					errors = errors + 1;
+				end
+
+				// The first slot is partial
+				if (n_runs > 0) begin
+					if ((run < 125) || (run > 126))
+						n_short = n_short + 1;
+				end
+				n_runs = n_runs + 1;
+				run = 0;
+			end
+
+			if (valid_1)
+				run = run + 1;
+
+			slot_prev = slot;
+		end
+	end
+
+	// RF loopback : random samples, each slot with its own delay, scale and
+	// gate. Every output sample must be the input delayed by the delay of
+	// one slot, scaled by the scale of that same slot (or 0 if gated).
+	localparam integer LB_DELAY = 40;
+
+	reg  [11:0] lb_x_i [0:1023];
+	reg  [11:0] lb_x_q [0:1023];
+	reg  lb_chk = 1'b0;
+	integer lb_lat;
+	integer lb_n, lb_match, lb_miss;
+	integer lb_hits [0:7];
+	integer m, t, u;
+
+	function integer lb_scale;
+		input integer s;
+		lb_scale = 16'h4000 - 16'h0600 * s;
+	endfunction
+
+	function integer lb_extra;
+		input integer s;
+		lb_extra = 7 * s;
+	endfunction
+
+	function lb_gate;
+		input integer s;
+		lb_gate = (s != 3) && (s != 6);
+	endfunction
+
+	function integer lb_exp;
+		input [11:0] x;
+		input integer s;
+		lb_exp = lb_gate(s) ? (($signed(x) * lb_scale(s)) >>> 14) : 0;
+	endfunction
+
+	function lb_near;
+		input [11:0] y;
+		input integer e;
+		lb_near = ($signed(y) >= e - 1) && ($signed(y) <= e + 1);
+	endfunction
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			rx_data_i <= 12'd0;
+			rx_data_q <= 12'd0;
+			lb_n = 0;
+			lb_miss = 0;
+			for (t=0; t<8; t=t+1)
+				lb_hits[t] = 0;
+		end else if (data_valid) begin
+			lb_x_i[lb_n % 1024] = rx_data_i;
+			lb_x_q[lb_n % 1024] = rx_data_q;
+
+			if (lb_chk) begin
+				lb_match = 0;
+				for (t=0; t<8; t=t+1)
+				begin
+					m = (lb_n - lb_lat - LB_DELAY - lb_extra(t)) % 1024;
+					if (lb_near(out_data_i, lb_exp(lb_x_i[m], t)) &&
+					    lb_near(out_data_q, lb_exp(lb_x_q[m], t))) begin
+						lb_hits[t] = lb_hits[t] + 1;
+						lb_match = lb_match + 1;
+					end
+				end
+
+				if (lb_match == 0) begin
+					if (lb_miss < 10)
+						$display("[!] Loopback sample %0d : %0d %0d matches no slot", lb_n, $signed(out_data_i), $signed(out_data_q));
+					lb_miss = lb_miss + 1;
+				end
+			end
+
+			rx_data_i <= $random;
+			rx_data_q <= $random;
+			lb_n = lb_n + 1;
+		end
+	end
+
+	task up_write;
+		input [5:0] addr;
+		input [31:0] data;
+		begin
+			@(posedge clk);
+			up_waddr <= { 6'h11, 2'b10, addr };
+			up_wdata <= data;
+			up_wreq  <= 1'b1;
+			@(posedge clk);
+			up_wreq  <= 1'b0;
+		end
+	endtask
+
+	task lb_run;
+		input [31:0] ctrl;
+		input integer lat;
+		begin
+			lb_chk = 1'b0;
+			up_write(6'h00, ctrl);
+			repeat (2 * 400) @(posedge clk);
+
+			lb_lat = lat;
+			lb_miss = 0;
+			for (u=0; u<8; u=u+1)
+				lb_hits[u] = 0;
+			lb_chk = 1'b1;
+			repeat (2 * 3000) @(posedge clk);
+			lb_chk = 1'b0;
+
+			if (lb_miss != 0) begin
+				$display("[!] Loopback ctrl %02x : %0d samples mixing slots", ctrl, lb_miss);
+				errors = errors + 1;
+			end
+
+			for (u=0; u<8; u=u+1)
+				if (lb_hits[u] < 200) begin
+					$display("[!] Loopback ctrl %02x : slot %0d only matched %0d samples", ctrl, u, lb_hits[u]);
+					errors = errors + 1;
+				end
+		end
+	endtask
+
+	integer s;
+
+	initial begin
+		offset = 32'd0;
+		for (s=0; s<8; s=s+1)
+			slot_table[32*s+:32] = 32'ha5000000 + (s << 8) + s;
+
+		up_wreq  = 1'b0;
+		up_waddr = 14'd0;
+		up_wdata = 32'd0;
+
+		# 21 rst = 0;
+
+		// 5 frames, the first slot doesn't start a run
+		repeat (2 * 5000) @(posedge clk);
+
+		if ((n_runs < 39) || (n_short != 0)) begin
+			$display("[!] %0d slots, %0d of the wrong length", n_runs, n_short);
+			errors = errors + 1;
+		end
+
+		// Shift by half a slot, 40 samples into one : that single slot is
+		// cut short
+		repeat (2 * 40) @(posedge clk);
+		offset = 32'h10000000;
+		repeat (2 * 5000) @(posedge clk);
+
+		if (n_short != 1) begin
+			$display("[!] Offset : %0d slots of the wrong length", n_short);
+			errors = errors + 1;
+		end
+
+		// RF loopback, 96 samples frames (12 per slot)
+		up_write(6'h01, LB_DELAY);
+		up_write(6'h06, 32'd0);
+		up_write(6'h07, 32'd44739243);
+		up_write(6'h0a, 32'd0);
+		up_write(6'h0b, 32'd0);
+		up_write(6'h0d, 32'd0);
+		up_write(6'h0e, 32'h00004000);
+		up_write(6'h11, 32'd0);
+		for (s=0; s<8; s=s+1)
+			up_write(6'h30 + s, (lb_gate(s) << 31) | (lb_extra(s) << 16) | lb_scale(s));
+
+		// Delay line only, then with the fractional delay filter, rotation
+		// and fading all set to identity. Besides the delay, the chain
+		// takes 7 samples, 6 more through the rotation and fading with a
+		// valid sample every other clock.
+		lb_run(32'h10, 7);
+		lb_run(32'h1e, 13);
+
+		// Result
+		if (errors == 0)
+			$display("[+] sig_tdma_tb: PASS");
+		else
+			$display("[!] sig_tdma_tb: FAIL (%0d errors)", errors);
+
+		$finish;
+	end
+
+endmodule // sig_tdma_tb
@@ -0,0 +1,168 @@
+/*
+ * sim_axi_mem.v
+ *
+ * Behavioral AXI4 memory model for simulation (64 bits, INCR bursts)
+ *
+ * Handshakes and response latencies are randomized to exercise the
+ * masters flow control.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`default_nettype none
+
+module sim_axi_mem #(
+	parameter integer AWIDTH = 16,		// Memory size is 2^AWIDTH bytes
+	parameter integer LATENCY = 16		// Maximum random latency
+)(
+	// Write
+	input  wire [31:0] s_axi_awaddr,
+	input  wire [ 7:0] s_axi_awlen,
+	input  wire        s_axi_awvalid,
+	output reg         s_axi_awready,
+	input  wire [63:0] s_axi_wdata,
+	input  wire [ 7:0] s_axi_wstrb,
+	input  wire        s_axi_wlast,
+	input  wire        s_axi_wvalid,
+	output reg         s_axi_wready,
+	output wire [ 1:0] s_axi_bresp,
+	output reg         s_axi_bvalid,
+	input  wire        s_axi_bready,
+
+	// Read
+	input  wire [31:0] s_axi_araddr,
+	input  wire [ 7:0] s_axi_arlen,
+	input  wire        s_axi_arvalid,
+	output reg         s_axi_arready,
+	output reg  [63:0] s_axi_rdata,
+	output wire [ 1:0] s_axi_rresp,
+	output reg         s_axi_rlast,
+	output reg         s_axi_rvalid,
+	input  wire        s_axi_rready,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Storage
+	reg [63:0] mem [0:(1<<(AWIDTH-3))-1];
+
+	// Write state
+	reg        w_busy;
+	reg [31:0] w_addr;
+	reg        w_resp;
+	integer    w_wait;
+
+	// Read state
+	reg        r_busy;
+	reg [31:0] r_addr;
+	reg [ 8:0] r_left;
+	integer    r_wait;
+
+	integer i;
+
+	initial
+		for (i=0; i<(1<<(AWIDTH-3)); i=i+1)
+			mem[i] = 64'hdeadbeefdeadbeef;
+
+	assign s_axi_bresp = 2'b00;
+	assign s_axi_rresp = 2'b00;
+
+
+	// Write
+	// -----
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			w_busy <= 1'b0;
+			w_resp <= 1'b0;
+			s_axi_awready <= 1'b0;
+			s_axi_wready  <= 1'b0;
+			s_axi_bvalid  <= 1'b0;
+		end else begin
+			// Address
+			s_axi_awready <= ~w_busy & ~s_axi_awready & (($random & 3) == 0);
+
+			if (s_axi_awvalid & s_axi_awready) begin
+				w_busy <= 1'b1;
+				w_addr <= s_axi_awaddr;
+			end
+
+			// Data
+			s_axi_wready <= w_busy & ~w_resp & (($random & 1) == 0);
+
+			if (s_axi_wvalid & s_axi_wready) begin
+				if (s_axi_wstrb != 8'hff)
+					$display("[!] sim_axi_mem: partial writes not supported");
+				mem[w_addr[AWIDTH-1:3]] <= s_axi_wdata;
+				w_addr <= w_addr + 8;
+				if (s_axi_wlast) begin
+					w_resp <= 1'b1;
+					w_wait <= $unsigned($random) % LATENCY;
+					s_axi_wready <= 1'b0;
+				end
+			end
+
+			// Response
+			if (w_resp & ~s_axi_bvalid) begin
+				if (w_wait == 0)
+					s_axi_bvalid <= 1'b1;
+				else
+					w_wait <= w_wait - 1;
+			end
+
+			if (s_axi_bvalid & s_axi_bready) begin
+				s_axi_bvalid <= 1'b0;
+				w_resp <= 1'b0;
+				w_busy <= 1'b0;
+			end
+		end
+	end
+
+
+	// Read
+	// ----
+
+	always @(posedge clk)
+	begin
+		if (rst) begin
+			r_busy <= 1'b0;
+			r_left <= 0;
+			s_axi_arready <= 1'b0;
+			s_axi_rvalid  <= 1'b0;
+			s_axi_rlast   <= 1'b0;
+		end else begin
+			// Address
+			s_axi_arready <= ~r_busy & ~s_axi_arready & (($random & 3) == 0);
+
+			if (s_axi_arvalid & s_axi_arready) begin
+				r_busy <= 1'b1;
+				r_addr <= s_axi_araddr;
+				r_left <= s_axi_arlen + 1;
+				r_wait <= $unsigned($random) % LATENCY;
+			end
+
+			// Data
+			if (s_axi_rvalid & s_axi_rready) begin
+				s_axi_rvalid <= 1'b0;
+				if (s_axi_rlast)
+					r_busy <= 1'b0;
+			end else if (r_busy & ~s_axi_rvalid & (r_left != 0)) begin
+				if (r_wait != 0)
+					r_wait <= r_wait - 1;
+				else if ($random & 1) begin
+					s_axi_rvalid <= 1'b1;
+					s_axi_rdata  <= mem[r_addr[AWIDTH-1:3]];
+					s_axi_rlast  <= (r_left == 1);
+					r_addr <= r_addr + 8;
+					r_left <= r_left - 1;
+				end
+			end
+		end
+	end
+
+endmodule // sim_axi_mem
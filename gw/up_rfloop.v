@@ -0,0 +1,393 @@
+/*
+ * up_rfloop.v
+ *
+ * Register bank for one I/Q RF loopback chain
+ *
+ * Sits on the ADI 'up' bus of the DAC core, in the unused channel slots
+ * 8-15 (0x0600 + 0x100 * PAIR_ID from the DDS core base, 64 registers).
+ *
+ *  0x00  CTRL      [0] Long delay (DDR) mode
+ *                  [1] NCO (frequency shift / phase rotation) enable
+ *                  [2] Fractional delay enable
+ *                  [3] Fading enable
+ *                  [4] TDMA slot table enable
+ *                  [5] Delay ramp enable
+ *                  [6] Delay ramp ping-pong mode
+ *                  Writing CTRL transfers the whole configuration to the
+ *                  datapath at once and clears the sticky status bits
+ *  0x01  DELAY     Delay in samples (integer part)
+ *  0x02  SCALE     [15:0] Echo scale (signed Q2.14)
+ *  0x03  STATUS    (RO) [0] DDR underflow, [1] DDR overflow
+ *  0x04  DDR_BASE  Byte address of the DDR ring buffer
+ *  0x05  DDR_SIZE  Size of the DDR ring buffer in bytes (power of two)
+ *  0x06  DELAY_FRAC [15:0] Delay fractional part, in 1/65536 samples
+ *  0x07  TDMA_STEP Frame phase step, in frames per sample * 2^32
+ *                  (see `sig_tdma.v`)
+ *  0x08  RAMP_RATE Delay ramp rate, in samples per sample * 2^32 (signed,
+ *                  see `sig_ramp.v`). The ramp starts from DELAY /
+ *                  DELAY_FRAC on each CTRL write
+ *  0x09  RAMP_BOUNDS [15:0] Delay ramp lower bound, [31:16] upper bound,
+ *                  in samples
+ *  0x0a  NCO_FREQ  Frequency shift in turns per sample * 2^32 (signed)
+ *  0x0b  NCO_PHASE [15:0] Phase offset in turns * 2^16
+ *  0x0c  NOISE_LEVEL [15:0] Added noise level, standard deviation of
+ *                  0.05103 LSBs per unit on each rail (see `sig_noise.v`),
+ *                  0 disables
+ *  0x0d  FADE_DOPPLER [23:0] Fading maximum Doppler shift, in turns per
+ *                  sample * 2^32 (see `sig_fading.v`)
+ *  0x0e  FADE_GAIN [15:0] Fading line of sight amplitude (signed Q2.14)
+ *                  [31:16] Fading diffuse amplitude (signed Q2.14)
+ *  0x0f  TDMA_OFFSET Frame phase offset, in frames * 2^32. Adjusts the
+ *                  slot boundaries to the received frame timing
+ *
+ *  0x10 + 2*(k-1)  TAP_DELAY  Tap k (1..N_TAPS-1) delay, in samples after
+ *                             the main one (tap 0, DELAY / SCALE)
+ *  0x11 + 2*(k-1)  TAP_SCALE  [15:0] Tap k scale (signed Q2.14)
+ *
+ *  The whole tap table is committed by the CTRL write too. Up to 12 taps
+ *  fit in the map (0x10 - 0x25).
+ *
+ *  0x26  PROBE_CTRL   W: [0] Start a latency measurement (see `sig_probe.v`)
+ *                      R: [0] Busy, [1] Done
+ *  0x27  PROBE_RESULT (RO) [15:0] Round trip latency in samples,
+ *                      [31:16] Correlation peak
+ *
+ *  0x28 - 0x2f  STATS  (RO) Telemetry, see `sig_stats.v`, refreshed at the
+ *                      end of each statistics window
+ *
+ *  0x30 + s  SLOT      TDMA slot s (0..7) entry, used instead of SCALE and
+ *                      added to DELAY for the samples sent in that slot
+ *                      when CTRL[4] is set :
+ *                      [15:0] Echo scale (signed Q2.14)
+ *                      [30:16] Extra delay in samples
+ *                      [31] Gate, the echo and its taps are muted in the
+ *                      slot when clear
+ *                      The scale and gate follow the delay down the chain,
+ *                      so each output sample gets all three from the same
+ *                      slot
+ *
+ *  The slot table is committed by the CTRL write too.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module up_rfloop #(
+	parameter integer PAIR_ID = 0,
+	parameter integer N_TAPS  = 6
+)(
+	// Datapath config (clk domain)
+	output reg  [31:0] cfg_ctrl,
+	output reg  [31:0] cfg_delay,
+	output reg  [15:0] cfg_delay_frac,
+	output reg  [15:0] cfg_scale,
+	output reg  [31:0] cfg_ddr_base,
+	output reg  [31:0] cfg_ddr_size,
+	output reg  [31:0] cfg_nco_freq,
+	output reg  [15:0] cfg_nco_phase,
+	output reg  [15:0] cfg_noise_level,
+	output reg  [23:0] cfg_fade_doppler,
+	output reg  [31:0] cfg_fade_gain,
+	output reg  [(N_TAPS-1)*16-1:0] cfg_tap_delay,
+	output reg  [(N_TAPS-1)*16-1:0] cfg_tap_scale,
+	output reg  [31:0] cfg_tdma_step,
+	output reg  [31:0] cfg_tdma_offset,
+	output reg  [8*32-1:0] cfg_slot_table,
+	output reg  [31:0] cfg_ramp_rate,
+	output reg  [31:0] cfg_ramp_bounds,
+	output reg         cfg_load,
+	output reg         cfg_probe_start,
+
+	// Datapath status (clk domain)
+	input  wire [ 1:0] stat_flags,
+	input  wire [8*32-1:0] stat_regs,
+	input  wire        stat_update,
+	input  wire [ 1:0] probe_flags,
+	input  wire [31:0] probe_result,
+
+	input  wire clk,
+
+	// Processor interface
+	input  wire        up_rstn,
+	input  wire        up_clk,
+	input  wire        up_wreq,
+	input  wire [13:0] up_waddr,
+	input  wire [31:0] up_wdata,
+	output reg         up_wack,
+	input  wire        up_rreq,
+	input  wire [13:0] up_raddr,
+	output reg  [31:0] up_rdata,
+	output reg         up_rack
+);
+
+	// Signals
+	// -------
+
+	// Bus decode
+	wire up_wreq_s;
+	wire up_rreq_s;
+
+	// Registers (up_clk domain)
+	reg  [31:0] up_ctrl;
+	reg  [31:0] up_delay;
+	reg  [15:0] up_delay_frac;
+	reg  [15:0] up_scale;
+	reg  [31:0] up_ddr_base;
+	reg  [31:0] up_ddr_size;
+	reg  [31:0] up_nco_freq;
+	reg  [15:0] up_nco_phase;
+	reg  [15:0] up_noise_level;
+	reg  [23:0] up_fade_doppler;
+	reg  [31:0] up_fade_gain;
+	reg  [(N_TAPS-1)*16-1:0] up_tap_delay;
+	reg  [(N_TAPS-1)*16-1:0] up_tap_scale;
+	reg  [31:0] up_tdma_step;
+	reg  [31:0] up_tdma_offset;
+	reg  [8*32-1:0] up_slot_table;
+	reg  [31:0] up_ramp_rate;
+	reg  [31:0] up_ramp_bounds;
+	reg  [31:0] up_misc_rdata;
+	reg         up_load_toggle;
+	reg         up_probe_toggle;
+
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 1:0] up_stat_sync_0;
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 1:0] up_stat_sync_1;
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 2:0] up_stat_update_sync;
+	reg  [8*32-1:0] up_stat_regs;
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 1:0] up_probe_sync_0;
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 1:0] up_probe_sync_1;
+	reg  [31:0] up_probe_result;
+
+	integer k;
+
+	// Transfer (clk domain)
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 2:0] load_sync = 3'b000;
+	(* ASYNC_REG = "TRUE" *)
+	reg  [ 2:0] probe_sync = 3'b000;
+
+
+	// Processor write interface
+	// -------------------------
+
+	assign up_wreq_s = ((up_waddr[13:8] == 6'h11) && (up_waddr[7:6] == { 1'b1, PAIR_ID[0] })) ? up_wreq : 1'b0;
+
+	always @(negedge up_rstn or posedge up_clk)
+	begin
+		if (up_rstn == 1'b0) begin
+			up_wack        <= 1'b0;
+			up_ctrl        <= 32'd0;
+			up_delay       <= 32'd0;
+			up_delay_frac  <= 16'd0;
+			up_scale       <= 16'd0;
+			up_ddr_base    <= 32'd0;
+			up_ddr_size    <= 32'd0;
+			up_nco_freq    <= 32'd0;
+			up_nco_phase   <= 16'd0;
+			up_noise_level <= 16'd0;
+			up_fade_doppler <= 24'd0;
+			up_fade_gain   <= 32'd0;
+			up_tap_delay   <= 0;
+			up_tap_scale   <= 0;
+			up_tdma_step   <= 32'd0;
+			up_tdma_offset <= 32'd0;
+			up_slot_table  <= 0;
+			up_ramp_rate   <= 32'd0;
+			up_ramp_bounds <= 32'd0;
+			up_load_toggle <= 1'b0;
+			up_probe_toggle <= 1'b0;
+		end else begin
+			up_wack <= up_wreq_s;
+
+			if (up_wreq_s) begin
+				case (up_waddr[5:0])
+					6'h00: begin
+						up_ctrl <= up_wdata;
+						up_load_toggle <= ~up_load_toggle;
+					end
+					6'h01: up_delay    <= up_wdata;
+					6'h02: up_scale    <= up_wdata[15:0];
+					6'h04: up_ddr_base <= up_wdata;
+					6'h05: up_ddr_size <= up_wdata;
+					6'h06: up_delay_frac <= up_wdata[15:0];
+					6'h07: up_tdma_step <= up_wdata;
+					6'h08: up_ramp_rate <= up_wdata;
+					6'h09: up_ramp_bounds <= up_wdata;
+					6'h0a: up_nco_freq <= up_wdata;
+					6'h0b: up_nco_phase <= up_wdata[15:0];
+					6'h0c: up_noise_level <= up_wdata[15:0];
+					6'h0d: up_fade_doppler <= up_wdata[23:0];
+					6'h0e: up_fade_gain <= up_wdata;
+					6'h0f: up_tdma_offset <= up_wdata;
+					6'h26: up_probe_toggle <= up_probe_toggle ^ up_wdata[0];
+					default: ;
+				endcase
+
+				for (k=0; k<N_TAPS-1; k=k+1)
+				begin
+					if (up_waddr[5:0] == (6'h10 + 2*k))
+						up_tap_delay[16*k+:16] <= up_wdata[15:0];
+					if (up_waddr[5:0] == (6'h11 + 2*k))
+						up_tap_scale[16*k+:16] <= up_wdata[15:0];
+				end
+
+				if (up_waddr[5:3] == 3'b110)
+					up_slot_table[32*up_waddr[2:0]+:32] <= up_wdata;
+			end
+		end
+	end
+
+
+	// Processor read interface
+	// ------------------------
+
+	assign up_rreq_s = ((up_raddr[13:8] == 6'h11) && (up_raddr[7:6] == { 1'b1, PAIR_ID[0] })) ? up_rreq : 1'b0;
+
+	always @(negedge up_rstn or posedge up_clk)
+	begin
+		if (up_rstn == 1'b0) begin
+			up_stat_sync_0 <= 2'b00;
+			up_stat_sync_1 <= 2'b00;
+		end else begin
+			up_stat_sync_0 <= stat_flags;
+			up_stat_sync_1 <= up_stat_sync_0;
+		end
+	end
+
+	// The stat_regs are stable for a whole statistics window after each
+	// toggle of stat_update
+	always @(negedge up_rstn or posedge up_clk)
+	begin
+		if (up_rstn == 1'b0) begin
+			up_stat_update_sync <= 3'b000;
+			up_stat_regs <= 0;
+		end else begin
+			up_stat_update_sync <= { up_stat_update_sync[1:0], stat_update };
+			if (up_stat_update_sync[2] ^ up_stat_update_sync[1])
+				up_stat_regs <= stat_regs;
+		end
+	end
+
+	// The probe result is stable once done is set
+	always @(negedge up_rstn or posedge up_clk)
+	begin
+		if (up_rstn == 1'b0) begin
+			up_probe_sync_0 <= 2'b00;
+			up_probe_sync_1 <= 2'b00;
+			up_probe_result <= 32'd0;
+		end else begin
+			up_probe_sync_0 <= probe_flags;
+			up_probe_sync_1 <= up_probe_sync_0;
+			if (up_probe_sync_1[1] & ~up_probe_sync_1[0])
+				up_probe_result <= probe_result;
+		end
+	end
+
+	always @(*)
+	begin
+		up_misc_rdata = 32'd0;
+
+		for (k=0; k<N_TAPS-1; k=k+1)
+		begin
+			if (up_raddr[5:0] == (6'h10 + 2*k))
+				up_misc_rdata = { 16'd0, up_tap_delay[16*k+:16] };
+			if (up_raddr[5:0] == (6'h11 + 2*k))
+				up_misc_rdata = { 16'd0, up_tap_scale[16*k+:16] };
+		end
+
+		if (up_raddr[5:3] == 3'b101)
+			up_misc_rdata = up_stat_regs[32*up_raddr[2:0]+:32];
+
+		if (up_raddr[5:3] == 3'b110)
+			up_misc_rdata = up_slot_table[32*up_raddr[2:0]+:32];
+	end
+
+	always @(negedge up_rstn or posedge up_clk)
+	begin
+		if (up_rstn == 1'b0) begin
+			up_rack  <= 1'b0;
+			up_rdata <= 32'd0;
+		end else begin
+			up_rack <= up_rreq_s;
+
+			if (up_rreq_s) begin
+				case (up_raddr[5:0])
+					6'h00:   up_rdata <= up_ctrl;
+					6'h01:   up_rdata <= up_delay;
+					6'h02:   up_rdata <= { 16'd0, up_scale };
+					6'h03:   up_rdata <= { 30'd0, up_stat_sync_1 };
+					6'h04:   up_rdata <= up_ddr_base;
+					6'h05:   up_rdata <= up_ddr_size;
+					6'h06:   up_rdata <= { 16'd0, up_delay_frac };
+					6'h07:   up_rdata <= up_tdma_step;
+					6'h08:   up_rdata <= up_ramp_rate;
+					6'h09:   up_rdata <= up_ramp_bounds;
+					6'h0a:   up_rdata <= up_nco_freq;
+					6'h0b:   up_rdata <= { 16'd0, up_nco_phase };
+					6'h0c:   up_rdata <= { 16'd0, up_noise_level };
+					6'h0d:   up_rdata <= { 8'd0, up_fade_doppler };
+					6'h0e:   up_rdata <= up_fade_gain;
+					6'h0f:   up_rdata <= up_tdma_offset;
+					6'h26:   up_rdata <= { 30'd0, up_probe_sync_1 };
+					6'h27:   up_rdata <= up_probe_result;
+					default: up_rdata <= up_misc_rdata;
+				endcase
+			end else begin
+				up_rdata <= 32'd0;
+			end
+		end
+	end
+
+
+	// Transfer to datapath
+	// --------------------
+
+	// The up_* registers are stable by the time the toggle makes it
+	// through the synchronizer, as long as they're not written in the
+	// few clk cycles following a CTRL write.
+	always @(posedge clk)
+		load_sync <= { load_sync[1:0], up_load_toggle };
+
+	always @(posedge clk)
+	begin
+		cfg_load <= load_sync[2] ^ load_sync[1];
+
+		if (load_sync[2] ^ load_sync[1]) begin
+			cfg_ctrl     <= up_ctrl;
+			cfg_delay    <= up_delay;
+			cfg_delay_frac <= up_delay_frac;
+			cfg_scale    <= up_scale;
+			cfg_ddr_base <= up_ddr_base;
+			cfg_ddr_size <= up_ddr_size;
+			cfg_nco_freq <= up_nco_freq;
+			cfg_nco_phase <= up_nco_phase;
+			cfg_noise_level <= up_noise_level;
+			cfg_fade_doppler <= up_fade_doppler;
+			cfg_fade_gain <= up_fade_gain;
+			cfg_tap_delay <= up_tap_delay;
+			cfg_tap_scale <= up_tap_scale;
+			cfg_tdma_step <= up_tdma_step;
+			cfg_tdma_offset <= up_tdma_offset;
+			cfg_slot_table <= up_slot_table;
+			cfg_ramp_rate <= up_ramp_rate;
+			cfg_ramp_bounds <= up_ramp_bounds;
+		end
+	end
+
+	always @(posedge clk)
+	begin
+		probe_sync <= { probe_sync[1:0], up_probe_toggle };
+		cfg_probe_start <= probe_sync[2] ^ probe_sync[1];
+	end
+
+endmodule // up_rfloop
@@ -0,0 +1,245 @@
+/*
+ * DSP48E1.v
+ *
+ * Lightweight DSP48E1 model for Verilator
+ *
+ * Only covers what the gateware uses, a lot faster than the full Xilinx
+ * behavioural model :
+ *
+ *  - A * B multiplier with AREG = BREG = MREG = PREG = CREG = 1 and the
+ *    INMODE / OPMODE / ALUMODE registers, no pre-adder (USE_DPORT "FALSE")
+ *  - X / Y / Z multiplexers, ALUMODE Z + X + Y + CIN or Z - (X + Y + CIN)
+ *  - No SIMD, no pattern detector, no A / B / carry cascades
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module DSP48E1 #(
+	parameter A_INPUT = "DIRECT",
+	parameter B_INPUT = "DIRECT",
+	parameter USE_DPORT = "FALSE",
+	parameter USE_MULT = "MULTIPLY",
+	parameter AUTORESET_PATDET = "NO_RESET",
+	parameter [47:0] MASK = 48'h3fffffffffff,
+	parameter [47:0] PATTERN = 48'h000000000000,
+	parameter SEL_MASK = "MASK",
+	parameter SEL_PATTERN = "PATTERN",
+	parameter USE_PATTERN_DETECT = "NO_PATDET",
+	parameter integer ACASCREG = 1,
+	parameter integer ADREG = 1,
+	parameter integer ALUMODEREG = 1,
+	parameter integer AREG = 1,
+	parameter integer BCASCREG = 1,
+	parameter integer BREG = 1,
+	parameter integer CARRYINREG = 1,
+	parameter integer CARRYINSELREG = 1,
+	parameter integer CREG = 1,
+	parameter integer DREG = 1,
+	parameter integer INMODEREG = 1,
+	parameter integer MREG = 1,
+	parameter integer OPMODEREG = 1,
+	parameter integer PREG = 1,
+	parameter USE_SIMD = "ONE48"
+)(
+	output wire [29:0] ACOUT,
+	output wire [17:0] BCOUT,
+	output wire CARRYCASCOUT,
+	output wire [ 3:0] CARRYOUT,
+	output wire MULTSIGNOUT,
+	output wire OVERFLOW,
+	output reg  [47:0] P,
+	output wire PATTERNBDETECT,
+	output wire PATTERNDETECT,
+	output wire [47:0] PCOUT,
+	output wire UNDERFLOW,
+	input  wire [29:0] A,
+	input  wire [29:0] ACIN,
+	input  wire [ 3:0] ALUMODE,
+	input  wire [17:0] B,
+	input  wire [17:0] BCIN,
+	input  wire [47:0] C,
+	input  wire CARRYCASCIN,
+	input  wire CARRYIN,
+	input  wire [ 2:0] CARRYINSEL,
+	input  wire CEA1,
+	input  wire CEA2,
+	input  wire CEAD,
+	input  wire CEALUMODE,
+	input  wire CEB1,
+	input  wire CEB2,
+	input  wire CEC,
+	input  wire CECARRYIN,
+	input  wire CECTRL,
+	input  wire CED,
+	input  wire CEINMODE,
+	input  wire CEM,
+	input  wire CEP,
+	input  wire CLK,
+	input  wire [24:0] D,
+	input  wire [ 4:0] INMODE,
+	input  wire MULTSIGNIN,
+	input  wire [ 6:0] OPMODE,
+	input  wire [47:0] PCIN,
+	input  wire RSTA,
+	input  wire RSTALLCARRYIN,
+	input  wire RSTALUMODE,
+	input  wire RSTB,
+	input  wire RSTC,
+	input  wire RSTCTRL,
+	input  wire RSTD,
+	input  wire RSTINMODE,
+	input  wire RSTM,
+	input  wire RSTP
+);
+
+	// Signals
+	// -------
+
+	reg  [29:0] a_reg;
+	reg  signed [17:0] b_reg;
+	reg  [47:0] c_reg;
+	reg  signed [42:0] m_reg;
+	reg  [ 6:0] opmode_reg;
+	reg  [ 3:0] alumode_reg;
+	reg  cin_reg;
+
+	reg  [47:0] x_mux;
+	reg  [47:0] y_mux;
+	reg  [47:0] z_mux;
+	wire [47:0] m_ext;
+	wire [47:0] cin_ext;
+
+
+	// Unsupported configs
+	// -------------------
+
+	// String parameters, compared against literals of other lengths
+	/* verilator lint_off WIDTH */
+	initial
+	begin
+		if ((A_INPUT != "DIRECT") || (B_INPUT != "DIRECT") ||
+		    (USE_DPORT != "FALSE") || (USE_MULT != "MULTIPLY") ||
+		    (USE_SIMD != "ONE48") ||
+		    (AREG != 1) || (BREG != 1) || (CREG != 1) || (MREG != 1) || (PREG != 1) ||
+		    (OPMODEREG != 1) || (ALUMODEREG != 1) || (CARRYINREG != 1))
+		begin
+			$display("[!] DSP48E1 %m : FAIL, configuration not supported by the lite model");
+			$finish;
+		end
+	end
+	/* verilator lint_on WIDTH */
+
+
+	// Input registers
+	// ---------------
+
+	// With AREG = BREG = 1 only A2 / B2 exist, INMODE is irrelevant
+	always @(posedge CLK)
+	begin
+		if (RSTA)
+			a_reg <= 0;
+		else if (CEA2)
+			a_reg <= A;
+
+		if (RSTB)
+			b_reg <= 0;
+		else if (CEB2)
+			b_reg <= B;
+
+		if (RSTC)
+			c_reg <= 0;
+		else if (CEC)
+			c_reg <= C;
+
+		if (RSTCTRL)
+			opmode_reg <= 0;
+		else if (CECTRL)
+			opmode_reg <= OPMODE;
+
+		if (RSTALUMODE)
+			alumode_reg <= 0;
+		else if (CEALUMODE)
+			alumode_reg <= ALUMODE;
+
+		if (RSTALLCARRYIN)
+			cin_reg <= 1'b0;
+		else if (CECARRYIN)
+			cin_reg <= CARRYIN;
+	end
+
+
+	// Multiplier
+	// ----------
+
+	always @(posedge CLK)
+	begin
+		if (RSTM)
+			m_reg <= 0;
+		else if (CEM)
+			m_reg <= $signed({ { 18{a_reg[24]} }, a_reg[24:0] }) * $signed({ { 25{b_reg[17]} }, b_reg });
+	end
+
+	assign m_ext = { { 5{m_reg[42]} }, m_reg };
+	assign cin_ext = { 47'd0, cin_reg };
+
+
+	// ALU
+	// ---
+
+	// The two partial products are modelled as M on X and 0 on Y
+	always @(*)
+	begin
+		case (opmode_reg[1:0])
+			2'b00:   x_mux = 48'h000000000000;
+			2'b01:   x_mux = m_ext;
+			2'b10:   x_mux = P;
+			default: x_mux = { a_reg, b_reg };
+		endcase
+
+		case (opmode_reg[3:2])
+			2'b00:   y_mux = 48'h000000000000;
+			2'b01:   y_mux = 48'h000000000000;
+			2'b10:   y_mux = 48'hffffffffffff;
+			default: y_mux = c_reg;
+		endcase
+
+		case (opmode_reg[6:4])
+			3'b001:  z_mux = PCIN;
+			3'b010:  z_mux = P;
+			3'b011:  z_mux = c_reg;
+			3'b100:  z_mux = P;
+			3'b101:  z_mux = { { 17{PCIN[47]} }, PCIN[47:17] };
+			3'b110:  z_mux = { { 17{P[47]} }, P[47:17] };
+			default: z_mux = 48'h000000000000;
+		endcase
+	end
+
+	always @(posedge CLK)
+	begin
+		if (RSTP)
+			P <= 48'h000000000000;
+		else if (CEP)
+			P <= (alumode_reg == 4'b0011) ?
+				z_mux - (x_mux + y_mux + cin_ext) :
+				z_mux + x_mux + y_mux + cin_ext;
+	end
+
+	assign PCOUT = P;
+
+	assign ACOUT          = 30'h00000000;
+	assign BCOUT          = 18'h00000;
+	assign CARRYCASCOUT   = 1'b0;
+	assign CARRYOUT       = 4'h0;
+	assign MULTSIGNOUT    = 1'b0;
+	assign OVERFLOW       = 1'b0;
+	assign PATTERNBDETECT = 1'b0;
+	assign PATTERNDETECT  = 1'b0;
+	assign UNDERFLOW      = 1'b0;
+
+endmodule // DSP48E1
@@ -0,0 +1,253 @@
+/*
+ * RAMB36E1.v
+ *
+ * Lightweight RAMB36E1 model for Verilator
+ *
+ * Only covers what the gateware uses, a lot faster than the full Xilinx
+ * behavioural model :
+ *
+ *  - "TDP" with the same width on both ports, or "SDP" 72 bits
+ *  - "READ_FIRST" write mode, DO*_REG 0 or 1, RSTREG_PRIORITY "RSTREG"
+ *  - Both ports on the same clock
+ *  - No ECC, no cascade, memory initialized to zero
+ *
+ * The memory layout matches the primitive : 512 words of 64 data bits and
+ * 8 parity bits, narrower ports address a slice of a word.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module RAMB36E1 #(
+	parameter RDADDR_COLLISION_HWCONFIG = "DELAYED_WRITE",
+	parameter SIM_COLLISION_CHECK = "ALL",
+	parameter integer DOA_REG = 0,
+	parameter integer DOB_REG = 0,
+	parameter EN_ECC_READ = "FALSE",
+	parameter EN_ECC_WRITE = "FALSE",
+	parameter RAM_EXTENSION_A = "NONE",
+	parameter RAM_EXTENSION_B = "NONE",
+	parameter RAM_MODE = "TDP",
+	parameter integer READ_WIDTH_A = 0,
+	parameter integer READ_WIDTH_B = 0,
+	parameter integer WRITE_WIDTH_A = 0,
+	parameter integer WRITE_WIDTH_B = 0,
+	parameter RSTREG_PRIORITY_A = "RSTREG",
+	parameter RSTREG_PRIORITY_B = "RSTREG",
+	parameter SIM_DEVICE = "7SERIES",
+	parameter [35:0] SRVAL_A = 36'h000000000,
+	parameter [35:0] SRVAL_B = 36'h000000000,
+	parameter WRITE_MODE_A = "WRITE_FIRST",
+	parameter WRITE_MODE_B = "WRITE_FIRST"
+)(
+	output wire [31:0] DOADO,
+	output wire [ 3:0] DOPADOP,
+	output wire [31:0] DOBDO,
+	output wire [ 3:0] DOPBDOP,
+	output wire CASCADEOUTA,
+	output wire CASCADEOUTB,
+	output wire DBITERR,
+	output wire SBITERR,
+	output wire [ 7:0] ECCPARITY,
+	output wire [ 8:0] RDADDRECC,
+	input  wire CASCADEINA,
+	input  wire CASCADEINB,
+	input  wire INJECTDBITERR,
+	input  wire INJECTSBITERR,
+	input  wire [15:0] ADDRARDADDR,
+	input  wire CLKARDCLK,
+	input  wire ENARDEN,
+	input  wire REGCEAREGCE,
+	input  wire RSTRAMARSTRAM,
+	input  wire RSTREGARSTREG,
+	input  wire [ 3:0] WEA,
+	input  wire [31:0] DIADI,
+	input  wire [ 3:0] DIPADIP,
+	input  wire [15:0] ADDRBWRADDR,
+	input  wire CLKBWRCLK,
+	input  wire ENBWREN,
+	input  wire REGCEB,
+	input  wire RSTRAMB,
+	input  wire RSTREGB,
+	input  wire [ 7:0] WEBWE,
+	input  wire [31:0] DIBDI,
+	input  wire [ 3:0] DIPBDIP
+);
+
+	localparam integer SDP = (RAM_MODE == "SDP") ? 1 : 0;
+
+	// Port width (with parity) and data / parity bits per access
+	localparam integer W  = SDP ? 72 : ((READ_WIDTH_A != 0) ? READ_WIDTH_A : WRITE_WIDTH_A);
+	localparam integer DW = (W >= 9) ? (W / 9) * 8 : W;
+	localparam integer PW = (W >= 9) ? (W / 9) : 0;
+
+	// Address LSBs ignored at that width
+	localparam integer AL = (DW == 1) ? 0 : (DW == 2) ? 1 : (DW == 4) ? 2 :
+	                        (DW == 8) ? 3 : (DW == 16) ? 4 : (DW == 32) ? 5 : 6;
+
+	// Signals
+	// -------
+
+	reg  [63:0] mem_d [0:511];
+	reg  [ 7:0] mem_p [0:511];
+
+	reg  [63:0] latch_a, latch_b;
+	reg  [ 7:0] latch_pa, latch_pb;
+	reg  [63:0] oreg_a, oreg_b;
+	reg  [ 7:0] oreg_pa, oreg_pb;
+
+	wire [63:0] di_sdp;
+	wire [ 7:0] dip_sdp;
+
+	wire [63:0] do_a, do_b;
+	wire [ 7:0] dop_a, dop_b;
+
+	integer i, j;
+
+
+	// Unsupported configs
+	// -------------------
+
+	// String parameters compared against literals of other lengths, and
+	// the power-on content (the INIT_xx defaults of the primitive) set
+	// non-blocking like the port writes, as Verilator can't mix both
+	// kinds of assignments on one memory
+	/* verilator lint_off WIDTH */
+	/* verilator lint_off INITIALDLY */
+	initial
+	begin
+		if ((SDP && ((READ_WIDTH_A != 72) || (WRITE_WIDTH_B != 72))) ||
+		    (!SDP && (READ_WIDTH_A != WRITE_WIDTH_A) && (READ_WIDTH_A != 0) && (WRITE_WIDTH_A != 0)) ||
+		    (!SDP && (READ_WIDTH_B != WRITE_WIDTH_B) && (READ_WIDTH_B != 0) && (WRITE_WIDTH_B != 0)) ||
+		    (WRITE_MODE_A != "READ_FIRST") || (WRITE_MODE_B != "READ_FIRST") ||
+		    (RSTREG_PRIORITY_A != "RSTREG") || (RSTREG_PRIORITY_B != "RSTREG") ||
+		    (EN_ECC_READ != "FALSE") || (EN_ECC_WRITE != "FALSE") ||
+		    (RAM_EXTENSION_A != "NONE") || (RAM_EXTENSION_B != "NONE"))
+		begin
+			$display("[!] RAMB36E1 %m : FAIL, configuration not supported by the lite model");
+			$finish;
+		end
+
+		for (i=0; i<512; i=i+1)
+		begin
+			mem_d[i] <= 64'h0000000000000000;
+			mem_p[i] <= 8'h00;
+		end
+	end
+	/* verilator lint_on INITIALDLY */
+	/* verilator lint_on WIDTH */
+
+
+	// Ports
+	// -----
+
+	assign di_sdp  = { DIBDI, DIADI };
+	assign dip_sdp = { DIPBDIP, DIPADIP };
+
+	// Both ports in one process : reads see the old content (READ_FIRST).
+	// Lane offsets in a word are computed on integers and wrapped to the
+	// word, like the primitive ignores the address bits above its width
+	/* verilator lint_off WIDTH */
+	always @(posedge CLKARDCLK)
+	begin
+		if (SDP) begin
+			// Port A reads, port B writes
+			if (ENARDEN) begin
+				if (RSTRAMARSTRAM) begin
+					latch_a  <= { SRVAL_B[31:0], SRVAL_A[31:0] };
+					latch_pa <= { SRVAL_B[35:32], SRVAL_A[35:32] };
+				end else begin
+					latch_a  <= mem_d[ADDRARDADDR[14:6]];
+					latch_pa <= mem_p[ADDRARDADDR[14:6]];
+				end
+			end
+
+			if (ENBWREN)
+				for (j=0; j<8; j=j+1)
+					if (WEBWE[j]) begin
+						mem_d[ADDRBWRADDR[14:6]][8*j+:8] <= di_sdp[8*j+:8];
+						mem_p[ADDRBWRADDR[14:6]][j] <= dip_sdp[j];
+					end
+		end else begin
+			// True dual port, same width
+			if (ENARDEN) begin
+				if (RSTRAMARSTRAM) begin
+					latch_a  <= { 32'h00000000, SRVAL_A[31:0] };
+					latch_pa <= { 4'h0, SRVAL_A[35:32] };
+				end else begin
+					latch_a  <= mem_d[ADDRARDADDR[14:6]] >> ((ADDRARDADDR[5:0] >> AL) * DW);
+					latch_pa <= (PW != 0) ? mem_p[ADDRARDADDR[14:6]] >> ((ADDRARDADDR[5:0] >> AL) * PW) : 8'h00;
+				end
+
+				if (WEA[0])
+					for (j=0; j<DW; j=j+1) begin
+						mem_d[ADDRARDADDR[14:6]][((ADDRARDADDR[5:0] >> AL) * DW + j) & 63] <= DIADI[j];
+						if (j < PW)
+							mem_p[ADDRARDADDR[14:6]][((ADDRARDADDR[5:0] >> AL) * PW + j) & 7] <= DIPADIP[j];
+					end
+			end
+
+			if (ENBWREN) begin
+				if (RSTRAMB) begin
+					latch_b  <= { 32'h00000000, SRVAL_B[31:0] };
+					latch_pb <= { 4'h0, SRVAL_B[35:32] };
+				end else begin
+					latch_b  <= mem_d[ADDRBWRADDR[14:6]] >> ((ADDRBWRADDR[5:0] >> AL) * DW);
+					latch_pb <= (PW != 0) ? mem_p[ADDRBWRADDR[14:6]] >> ((ADDRBWRADDR[5:0] >> AL) * PW) : 8'h00;
+				end
+
+				if (WEBWE[0])
+					for (j=0; j<DW; j=j+1) begin
+						mem_d[ADDRBWRADDR[14:6]][((ADDRBWRADDR[5:0] >> AL) * DW + j) & 63] <= DIBDI[j];
+						if (j < PW)
+							mem_p[ADDRBWRADDR[14:6]][((ADDRBWRADDR[5:0] >> AL) * PW + j) & 7] <= DIPBDIP[j];
+					end
+			end
+		end
+	end
+	/* verilator lint_on WIDTH */
+
+	// Optional output registers
+	always @(posedge CLKARDCLK)
+	begin
+		if (RSTREGARSTREG) begin
+			oreg_a  <= SDP ? { SRVAL_B[31:0], SRVAL_A[31:0] } : { 32'h00000000, SRVAL_A[31:0] };
+			oreg_pa <= SDP ? { SRVAL_B[35:32], SRVAL_A[35:32] } : { 4'h0, SRVAL_A[35:32] };
+		end else if (REGCEAREGCE) begin
+			oreg_a  <= latch_a;
+			oreg_pa <= latch_pa;
+		end
+
+		if (RSTREGB) begin
+			oreg_b  <= { 32'h00000000, SRVAL_B[31:0] };
+			oreg_pb <= { 4'h0, SRVAL_B[35:32] };
+		end else if (REGCEB) begin
+			oreg_b  <= latch_b;
+			oreg_pb <= latch_pb;
+		end
+	end
+
+	assign do_a  = DOA_REG ? oreg_a  : latch_a;
+	assign dop_a = DOA_REG ? oreg_pa : latch_pa;
+	assign do_b  = DOB_REG ? oreg_b  : latch_b;
+	assign dop_b = DOB_REG ? oreg_pb : latch_pb;
+
+	// In SDP mode, port B outputs carry the upper half of port A
+	assign DOADO   = do_a[31:0];
+	assign DOPADOP = dop_a[3:0];
+	assign DOBDO   = SDP ? do_a[63:32] : do_b[31:0];
+	assign DOPBDOP = SDP ? dop_a[7:4]  : dop_b[3:0];
+
+	assign CASCADEOUTA = 1'b0;
+	assign CASCADEOUTB = 1'b0;
+	assign DBITERR     = 1'b0;
+	assign SBITERR     = 1'b0;
+	assign ECCPARITY   = 8'h00;
+	assign RDADDRECC   = 9'h000;
+
+endmodule // RAMB36E1
@@ -0,0 +1,339 @@
+/*
+ * sig_chain_vlt.cpp
+ *
+ * Verilator regression for the delay lines and the combiners
+ *
+ * Drives `sig_chain_vlt` with random data for a few million cycles,
+ * sweeping the delay, the scales and the `data_valid` duty cycle, and
+ * checks every output cycle against a golden model. Prints the simulation
+ * speed at the end.
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "verilated.h"
+#include "Vsig_chain_vlt.h"
+
+
+#define HIST_LOG	16
+#define HIST_MASK	((1 << HIST_LOG) - 1)
+
+#define MAX_DELAY	32767		/* sig_delay is 15 bits */
+#define SETTLE		4			/* Valid samples not checked after a delay change */
+#define MAX_ERRORS	10
+
+
+/* ------------------------------------------------------------------------ */
+/* Random                                                                   */
+/* ------------------------------------------------------------------------ */
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint32_t
+rng(void)
+{
+	/* xorshift64* */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (uint32_t)((rng_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+static int
+rng_range(int min, int max)
+{
+	return min + (int)(rng() % (uint32_t)(max - min + 1));
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Golden model                                                             */
+/* ------------------------------------------------------------------------ */
+
+static int
+sext(uint32_t v, int bits)
+{
+	return (int)(v << (32 - bits)) >> (32 - bits);
+}
+
+/* Raw DSP48E1 P output of sig_combine (D_WIDTH 12, S_FRAC 14) */
+static int64_t
+combine_p(int data, int scale, int chain)
+{
+	return ((int64_t)data * 8192 * scale) + ((int64_t)chain << 27);
+}
+
+/* out_3 / out_sat_3 from P : bits 47:38 must all be the sign */
+static int
+combine_out(int64_t p, int *sat)
+{
+	if (p >= (1LL << 38)) {
+		*sat = 1;
+		return 2047;
+	} else if (p < -(1LL << 38)) {
+		*sat = 1;
+		return -2048;
+	}
+
+	*sat = 0;
+	return (int)(p >> 27);
+}
+
+/* Combiners inputs, as seen by the DSP at a given clock edge */
+struct comb_in {
+	int d1, s1, c;
+	int d2, s2;
+};
+
+
+/* ------------------------------------------------------------------------ */
+/* Test                                                                     */
+/* ------------------------------------------------------------------------ */
+
+struct segment {
+	int delay;
+	int scale;
+	int scale2;
+	int duty_num;		/* data_valid duty cycle : duty_num / duty_den */
+	int duty_den;
+	int duty_rand;		/* random pattern instead of a regular one */
+};
+
+static void
+segment_pick(struct segment *seg)
+{
+	static const int scales[] = { 0x4000, -0x4000, 0x7fff, -0x8000, 0, 1, 0x2000 };
+	static const int duty[][2] = { {1,1}, {1,2}, {1,3}, {1,4}, {3,4}, {1,8} };
+	int r;
+
+	/* Delay, with some bias to the edge cases */
+	r = rng() & 7;
+	seg->delay = (r == 0) ? rng_range(0, 3) :
+	             (r == 1) ? rng_range(MAX_DELAY - 3, MAX_DELAY) :
+	             rng_range(0, MAX_DELAY);
+
+	/* Scales, likewise */
+	seg->scale  = (rng() & 1) ? scales[rng() % 7] : sext(rng(), 16);
+	seg->scale2 = (rng() & 1) ? scales[rng() % 7] : sext(rng(), 16);
+
+	/* Valid duty cycle */
+	r = rng() % 6;
+	seg->duty_num  = duty[r][0];
+	seg->duty_den  = duty[r][1];
+	seg->duty_rand = rng() & 1;
+}
+
+static void
+usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-n cycles] [-s seed]\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	Vsig_chain_vlt *top;
+	struct segment seg = { 0, 0, 0, 1, 1, 0 };
+	struct comb_in cin[4];
+	int16_t hist_i[1 << HIST_LOG];
+	int16_t hist_q[1 << HIST_LOG];
+	int exp_i = 0, exp_q = 0;
+	uint64_t n_cycles = 10000000;
+	uint64_t n_valid = 0;
+	uint64_t n_checks = 0;
+	uint64_t n_sat = 0;
+	uint64_t cycle, seg_end = 0;
+	int seg_settle = 0;
+	int duty_phase = 0;
+	int errors = 0;
+	struct timespec t0, t1;
+	double dt;
+	int opt;
+
+	Verilated::commandArgs(argc, argv);
+
+	while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			n_cycles = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			rng_state = strtoull(optarg, NULL, 0) | 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : -1;
+		}
+	}
+
+	top = new Vsig_chain_vlt;
+
+	for (int i=0; i<(1 << HIST_LOG); i++)
+		hist_i[i] = hist_q[i] = 0;
+
+	memset(cin, 0x00, sizeof(cin));
+
+	/* Reset */
+	top->rst = 1;
+	top->clk = 0;
+	top->data_valid = 0;
+
+	for (int i=0; i<8; i++) {
+		top->clk = 1; top->eval();
+		top->clk = 0; top->eval();
+	}
+
+	top->rst = 0;
+
+	/* A lite model refusing its configuration ends the simulation */
+	if (Verilated::gotFinish()) {
+		fprintf(stderr, "[!] simulation finished during reset\n");
+		errors++;
+		n_cycles = 0;
+	}
+
+	/* Run */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (cycle=0; cycle<n_cycles; cycle++)
+	{
+		struct comb_in *cur;
+		int valid, di, dq, chain;
+		int o, s;
+
+		/* New segment */
+		if (cycle == seg_end) {
+			segment_pick(&seg);
+			seg_end = cycle + rng_range(10000, 200000);
+			seg_settle = SETTLE;
+		}
+
+		/* Inputs */
+		if (seg.duty_rand)
+			valid = (int)(rng() % seg.duty_den) < seg.duty_num;
+		else
+			valid = duty_phase < seg.duty_num;
+
+		duty_phase = (duty_phase + 1) % seg.duty_den;
+
+		switch (rng() & 15) {
+		case 0:  di = -2048; break;
+		case 1:  di =  2047; break;
+		default: di = sext(rng(), 12);
+		}
+
+		dq    = sext(rng(), 12);
+		chain = sext(rng(), 12);
+
+		top->data_valid = valid;
+		top->data_in_i  = di & 0xfff;
+		top->data_in_q  = dq & 0xfff;
+		top->chain_in   = chain & 0xfff;
+		top->delay      = seg.delay;
+		top->scale      = seg.scale & 0xffff;
+		top->scale2     = seg.scale2 & 0xffff;
+
+		/* What the DSPs see at this edge : the delay outputs before it */
+		cur = &cin[cycle & 3];
+		cur->d1 = sext(top->dly_out, 12);
+		cur->d2 = sext(top->iq_out_q, 12);
+		cur->s1 = seg.scale;
+		cur->s2 = seg.scale2;
+		cur->c  = chain;
+
+		/* Clock */
+		top->clk = 1; top->eval();
+		top->clk = 0; top->eval();
+
+		if (Verilated::gotFinish()) {
+			fprintf(stderr, "[!] cycle %llu : simulation finished early\n",
+				(unsigned long long)cycle);
+			errors++;
+			n_cycles = cycle + 1;
+			break;
+		}
+
+		/* Delay lines : output for valid sample n is input n - 2 - delay */
+		if (valid) {
+			hist_i[n_valid & HIST_MASK] = di;
+			hist_q[n_valid & HIST_MASK] = dq;
+
+			if (n_valid >= 2 + (uint64_t)seg.delay) {
+				exp_i = hist_i[(n_valid - 2 - seg.delay) & HIST_MASK];
+				exp_q = hist_q[(n_valid - 2 - seg.delay) & HIST_MASK];
+			} else {
+				exp_i = exp_q = 0;
+			}
+
+			n_valid++;
+
+			if (seg_settle)
+				seg_settle--;
+		}
+
+		if (!seg_settle && (n_valid > 4)) {
+			if ((sext(top->dly_out, 12) != exp_i) ||
+			    (sext(top->iq_out_i, 12) != exp_i) ||
+			    (sext(top->iq_out_q, 12) != exp_q))
+			{
+				if (errors++ < MAX_ERRORS)
+					fprintf(stderr, "[!] cycle %llu, delay %d : dly %d, iq %d/%d, expected %d/%d\n",
+						(unsigned long long)cycle, seg.delay,
+						sext(top->dly_out, 12), sext(top->iq_out_i, 12), sext(top->iq_out_q, 12),
+						exp_i, exp_q);
+			}
+			n_checks++;
+		}
+
+		/* Combiners : DIRECT is 3 cycles, CASCADE stage one more */
+		if (cycle >= 4) {
+			struct comb_in *c2 = &cin[(cycle - 2) & 3];
+			struct comb_in *c3 = &cin[(cycle - 3) & 3];
+
+			o = combine_out(combine_p(c2->d1, c2->s1, c2->c), &s);
+			if ((sext(top->comb_out, 12) != o) || (top->comb_sat != s)) {
+				if (errors++ < MAX_ERRORS)
+					fprintf(stderr, "[!] cycle %llu : comb %d (sat %d), expected %d (sat %d)\n",
+						(unsigned long long)cycle, sext(top->comb_out, 12), top->comb_sat, o, s);
+			}
+			n_sat += s;
+
+			o = combine_out(combine_p(c3->d1, c3->s1, c3->c) + combine_p(c3->d2, c3->s2, 0), &s);
+			if ((sext(top->casc_out, 12) != o) || (top->casc_sat != s)) {
+				if (errors++ < MAX_ERRORS)
+					fprintf(stderr, "[!] cycle %llu : casc %d (sat %d), expected %d (sat %d)\n",
+						(unsigned long long)cycle, sext(top->casc_out, 12), top->casc_sat, o, s);
+			}
+			n_sat += s;
+
+			n_checks += 2;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+	top->final();
+	delete top;
+
+	/* Report */
+	fprintf(stderr, "[.] %llu cycles, %llu valid samples, %llu checks, %llu saturated\n",
+		(unsigned long long)n_cycles, (unsigned long long)n_valid,
+		(unsigned long long)n_checks, (unsigned long long)n_sat);
+	fprintf(stderr, "[.] %.2f s, %.3f Mcycles/s\n", dt, n_cycles / dt * 1e-6);
+
+	if (errors == 0)
+		printf("[+] sig_chain_vlt: PASS\n");
+	else
+		printf("[!] sig_chain_vlt: FAIL (%d errors)\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * sig_chain_vlt.v
+ *
+ * Verilator top for the delay / combine regression (see sig_chain_vlt.cpp)
+ *
+ *  - `sig_delay` on the I rail and `sig_delay_iq` on I/Q, same delay
+ *  - `sig_combine` (DIRECT) : dly_out * scale + chain_in
+ *  - `sig_combine` (CASCADE) : previous + iq_out_q * scale2, data delayed
+ *    by one cycle as required by the systolic cascade
+ *
+ * Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+ *
+ * vim: ts=4 sw=4
+ */
+
+`ifdef SIM
+`default_nettype none
+`endif
+
+module sig_chain_vlt (
+	// Input
+	input  wire data_valid,
+	input  wire [11:0] data_in_i,
+	input  wire [11:0] data_in_q,
+	input  wire [11:0] chain_in,
+
+	// Config
+	input  wire [14:0] delay,
+	input  wire [15:0] scale,
+	input  wire [15:0] scale2,
+
+	// Output
+	output wire [11:0] dly_out,
+	output wire [11:0] iq_out_i,
+	output wire [11:0] iq_out_q,
+	output wire [11:0] comb_out,
+	output wire comb_sat,
+	output wire [11:0] casc_out,
+	output wire casc_sat,
+
+	// Control
+	input  wire clk,
+	input  wire rst
+);
+
+	// Signals
+	// -------
+
+	wire [47:0] pc;
+	reg  [11:0] casc_data_1;
+	reg  [15:0] casc_scale_1;
+
+
+	// Delay lines
+	// -----------
+
+	sig_delay #(
+		.WIDTH(12)
+	) delay_I (
+		.data_valid(data_valid),
+		.data_in(data_in_i),
+		.data_out(dly_out),
+		.delay(delay),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	sig_delay_iq #(
+		.WIDTH(12),
+		.DEPTH(32768)
+	) delay_iq_I (
+		.data_valid(data_valid),
+		.data_in_i(data_in_i),
+		.data_in_q(data_in_q),
+		.data_out_i(iq_out_i),
+		.data_out_q(iq_out_q),
+		.delay({ 1'b0, delay }),
+		.clk(clk),
+		.rst(rst)
+	);
+
+
+	// Combiners
+	// ---------
+
+	sig_combine #(
+		.D_WIDTH(12),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("DIRECT")
+	) comb_I (
+		.in_data_0(dly_out),
+		.in_scale_0(scale),
+		.in_chain_0(chain_in),
+		.in_pcin_2(48'h000000000000),
+		.out_3(comb_out),
+		.out_sat_3(comb_sat),
+		.out_pcout_3(pc),
+		.clk(clk),
+		.rst(rst)
+	);
+
+	always @(posedge clk)
+	begin
+		casc_data_1  <= iq_out_q;
+		casc_scale_1 <= scale2;
+	end
+
+	sig_combine #(
+		.D_WIDTH(12),
+		.S_WIDTH(16),
+		.S_FRAC(14),
+		.CHAIN_INPUT("CASCADE")
+	) casc_I (
+		.in_data_0(casc_data_1),
+		.in_scale_0(casc_scale_1),
+		.in_chain_0(12'h000),
+		.in_pcin_2(pc),
+		.out_3(casc_out),
+		.out_sat_3(casc_sat),
+		.out_pcout_3(),
+		.clk(clk),
+		.rst(rst)
+	);
+
+endmodule // sig_chain_vlt
@@ -10,6 +10,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <math.h>
+#include <strings.h>
 
 #include <iio.h>
 
@@ -34,6 +36,8 @@
 
 	voltage 0 -> RX1 I
 	voltage 1 -> RX1 Q
+	voltage 2 -> RX2 I (2RX2TX mode only)
+	voltage 3 -> RX2 Q (2RX2TX mode only)
 
 
 	Device: cf-ad9361-dds-core-lpc	=> TX Path + two tone synthesizer
@@ -41,10 +45,159 @@
 
 	voltage 0 -> TX1 I
 	voltage 1 -> TX1 Q
+	voltage 2 -> TX2 I (2RX2TX mode only)
+	voltage 3 -> TX2 Q (2RX2TX mode only)
 	altvoltage[] -> DDS stuff
 */
 
 
+/* DAC channel data source (see axi_ad9361_tx_channel.v), channel 2p / 2p+1
+ * are I / Q of RX(p+1) -> TX(p+1) */
+#define DAC_CHAN_SEL(n)		(0x80000418 + ((n) << 6))
+
+#define DAC_SEL_ZERO		0x3
+#define DAC_SEL_RFLB		0xa
+#define DAC_SEL_RFLB_DLY	0xb
+#define DAC_SEL_RX		0xc
+
+
+/* RF loopback registers (see gw/up_rfloop.v) */
+#define RFLB_REG(pair, idx)	(0x80000600 + ((pair) << 8) + ((idx) << 2))
+
+#define RFLB_CTRL		0x00
+#define RFLB_DELAY		0x01
+#define RFLB_SCALE		0x02
+#define RFLB_STATUS		0x03
+#define RFLB_DDR_BASE		0x04
+#define RFLB_DDR_SIZE		0x05
+#define RFLB_DELAY_FRAC		0x06
+#define RFLB_TDMA_STEP		0x07
+#define RFLB_RAMP_RATE		0x08
+#define RFLB_RAMP_BOUNDS	0x09
+#define RFLB_NCO_FREQ		0x0a
+#define RFLB_NCO_PHASE		0x0b
+#define RFLB_NOISE_LEVEL	0x0c
+#define RFLB_FADE_DOPPLER	0x0d
+#define RFLB_FADE_GAIN		0x0e
+#define RFLB_TDMA_OFFSET	0x0f
+#define RFLB_TAP_DELAY(k)	(0x10 + 2 * ((k) - 1))
+#define RFLB_TAP_SCALE(k)	(0x11 + 2 * ((k) - 1))
+#define RFLB_PROBE_CTRL		0x26
+#define RFLB_PROBE_RESULT	0x27
+#define RFLB_STATS		0x28
+#define RFLB_SLOT(s)		(0x30 + (s))
+
+#define RFLB_CTRL_LONG		(1 << 0)
+#define RFLB_CTRL_NCO		(1 << 1)
+#define RFLB_CTRL_FRAC		(1 << 2)
+#define RFLB_CTRL_FADE		(1 << 3)
+#define RFLB_CTRL_TDMA		(1 << 4)
+#define RFLB_CTRL_RAMP		(1 << 5)
+#define RFLB_CTRL_PINGPONG	(1 << 6)
+
+#define RFLB_SLOT_GATE		(1U << 31)
+
+#define RFLB_STATUS_UNDERFLOW	(1 << 0)
+#define RFLB_STATUS_OVERFLOW	(1 << 1)
+
+#define RFLB_PROBE_START	(1 << 0)
+#define RFLB_PROBE_BUSY		(1 << 0)
+#define RFLB_PROBE_DONE		(1 << 1)
+
+#define RFLB_STAT_VALID		0
+#define RFLB_STAT_SAT		1
+#define RFLB_STAT_RX_PEAK	2
+#define RFLB_STAT_RX_POWER_I	3
+#define RFLB_STAT_RX_POWER_Q	4
+#define RFLB_STAT_TX_PEAK	5
+#define RFLB_STAT_TX_POWER_I	6
+#define RFLB_STAT_TX_POWER_Q	7
+#define RFLB_STAT_COUNT		8
+
+#define RFLB_FULL_SCALE		2048.0
+
+/* Noise standard deviation per NOISE_LEVEL unit, in LSBs (209.0 / 4096) */
+#define RFLB_NOISE_SIGMA	0.05103
+#define RFLB_NOISE_MAX_LEVEL	65535
+
+/* Fading Doppler spread register width (turns per sample * 2^32) */
+#define RFLB_FADE_MAX_DOPPLER	0xffffff
+
+/* Longest delay the BRAM delay line can do (22 BRAMs x 1536 samples - 2) */
+#define RFLB_BRAM_MAX_DELAY	33790
+
+/* Shortest delay usable with a fractional part (latency of the filter) */
+#define RFLB_FRAC_MIN_DELAY	10
+
+/* Independent echo paths, one per RX/TX pair (rfloop instances) */
+#define RFLB_N_PAIRS		2
+
+/* Multipath taps, including the main one (must match gw/rfloop.v) */
+#define RFLB_N_TAPS		6
+#define RFLB_TAP_MAX_DELAY	255
+
+/* TDMA slots per frame and longest per slot extra delay */
+#define RFLB_N_SLOTS		8
+#define RFLB_SLOT_MAX_DELAY	32767
+
+/* Probe correlation peak (63 chips, (|I| + |Q|) / 8) below which the
+ * sequence is considered not received */
+#define RFLB_PROBE_MIN_PEAK	512
+
+/* Speed of light, m/s */
+#define SPEED_OF_LIGHT		299792458.0
+
+/* GSM bit and TDMA frame periods */
+#define GSM_BIT_PERIOD		(48e-6 / 13)
+#define GSM_FRAME_PERIOD	(60e-3 / 13)
+
+
+struct app_echo
+{
+	int   mux;			/* DAC data source */
+
+	int   delay;			/* samples, integer part */
+	int   delay_frac;		/* 1/65536 samples */
+	double delay_time;		/* seconds, < 0 if given in samples */
+	double latency;		/* samples, fixed round trip latency */
+	int   latency_set;	/* latency given with -l, kept over the calibration */
+	double gain;		/* actual / programmed delay, from the calibration */
+	float scale;
+	float doppler;		/* Hz */
+	float phase;		/* degrees */
+
+	float noise;		/* dBFS per rail, NAN if unused */
+	float snr;			/* dB relative to the echo, NAN if unused */
+	int   noise_level;	/* NOISE_LEVEL register */
+
+	float fading;		/* Hz, maximum Doppler spread, 0 if unused */
+	float rician_k;		/* dB, -INFINITY for Rayleigh */
+
+	/* Extra multipath taps, after the main echo */
+	struct {
+		int   delay;	/* samples */
+		float scale;
+	} taps[RFLB_N_TAPS - 1];
+	int n_taps;
+
+	/* TDMA slot table, unused if n_slots is 0 */
+	struct {
+		int   gate;		/* 0 mutes the echo in that slot */
+		float delay;	/* samples, or GSM bits if bits is set */
+		int   bits;
+		int   samples;	/* resolved delay, on top of the echo one */
+		float scale;
+	} slots[RFLB_N_SLOTS];
+	int n_slots;
+	float tdma_offset;	/* us, slot boundaries moved earlier by that */
+
+	/* Delay ramp, unused if speed is 0 */
+	float speed;		/* m/s, > 0 moving away */
+	double ramp_time[2];	/* seconds, lower / upper bound, < 0 if given in samples */
+	int   ramp_bound[2];	/* samples, lower / upper bound */
+	int   pingpong;
+};
+
 struct app_options
 {
 	long long tx_freq;	/* Hz */
@@ -57,8 +210,17 @@ struct app_options
 	int buf_cnt;
 	int buf_size;
 
-	int   echo_delay;
-	float echo_scale;
+	/* Echo paths, RX1 -> TX1 and RX2 -> TX2 (2RX2TX mode) */
+	struct app_echo echo[RFLB_N_PAIRS];
+	int n_chan;
+	int probe;
+
+	unsigned int ddr_base;	/* bytes, shared by all the paths */
+	unsigned int ddr_size;	/* bytes */
+
+	int stats;
+
+	const char *calib;	/* Calibration table, NULL if unused */
 };
 
 struct app_state
@@ -72,13 +234,11 @@ struct app_state
 		struct iio_device  *phy;
 
 		struct iio_device  *rx;
-		struct iio_channel *rx_i;
-		struct iio_channel *rx_q;
+		struct iio_channel *rx_ch[2 * RFLB_N_PAIRS];	/* I / Q */
 		struct iio_buffer  *rx_buf;
 
 		struct iio_device  *tx;
-		struct iio_channel *tx_i;
-		struct iio_channel *tx_q;
+		struct iio_channel *tx_ch[2 * RFLB_N_PAIRS];	/* I / Q */
 		struct iio_buffer  *tx_buf;
 	} pluto;
 };
@@ -89,6 +249,8 @@ static void app_pluto_close(struct app_state *app);
 static int
 app_pluto_open(struct app_state *app)
 {
+	char name[32];
+
 	/* NULL init */
 	memset(&app->pluto, 0x00, sizeof(app->pluto));
 
@@ -126,11 +288,14 @@ app_pluto_open(struct app_state *app)
 		app->opts.rx_freq
 	);
 
-	iio_channel_attr_write_double(
-		iio_device_find_channel(app->pluto.phy, "voltage0", false),
-		"hardwaregain",		/* RX gain */
-		(double)app->opts.rx_gain
-	);
+	for (int p=0; p<app->opts.n_chan; p++) {
+		snprintf(name, sizeof(name), "voltage%d", p);
+		iio_channel_attr_write_double(
+			iio_device_find_channel(app->pluto.phy, name, false),
+			"hardwaregain",		/* RX gain */
+			(double)app->opts.rx_gain
+		);
+	}
 
 	iio_channel_attr_write_longlong(
 		iio_device_find_channel(app->pluto.phy, "voltage0", false),
@@ -138,13 +303,6 @@ app_pluto_open(struct app_state *app)
 		app->opts.samp_rate
 	);
 
-		/* Channel config */
-	app->pluto.rx_i = iio_device_find_channel(app->pluto.rx, "voltage0", false);
-	app->pluto.rx_q = iio_device_find_channel(app->pluto.rx, "voltage1", false);
-
-	iio_channel_enable(app->pluto.rx_i);
-	iio_channel_enable(app->pluto.rx_q);
-
 	/* Configure TX */
 		/* Frequency / Gain / Sampling */
 	iio_channel_attr_write_longlong(
@@ -153,11 +311,14 @@ app_pluto_open(struct app_state *app)
 		app->opts.tx_freq
 	);
 
-	iio_channel_attr_write_double(
-		iio_device_find_channel(app->pluto.phy, "voltage0", true),
-		"hardwaregain",		/* TX gain */
-		(double)app->opts.tx_gain
-	);
+	for (int p=0; p<app->opts.n_chan; p++) {
+		snprintf(name, sizeof(name), "voltage%d", p);
+		iio_channel_attr_write_double(
+			iio_device_find_channel(app->pluto.phy, name, true),
+			"hardwaregain",		/* TX gain */
+			(double)app->opts.tx_gain
+		);
+	}
 
 	iio_channel_attr_write_longlong(
 		iio_device_find_channel(app->pluto.phy, "voltage0", true),
@@ -165,20 +326,21 @@ app_pluto_open(struct app_state *app)
 		app->opts.samp_rate
 	);
 
-		/* Channel config */
-	app->pluto.tx_i = iio_device_find_channel(app->pluto.tx, "voltage0", true);
-	app->pluto.tx_q = iio_device_find_channel(app->pluto.tx, "voltage1", true);
+	/* Channel config, I/Q of each used pair */
+	for (int i=0; i<2*app->opts.n_chan; i++) {
+		snprintf(name, sizeof(name), "voltage%d", i);
 
-	iio_channel_enable(app->pluto.tx_i);
-	iio_channel_enable(app->pluto.tx_q);
+		app->pluto.rx_ch[i] = iio_device_find_channel(app->pluto.rx, name, false);
+		app->pluto.tx_ch[i] = iio_device_find_channel(app->pluto.tx, name, true);
 
-	/* Configure the ECHO path */
-	uint16_t scale = (uint16_t)(0x4000 * app->opts.echo_scale);
-	uint16_t delay = app->opts.echo_delay;
-	uint32_t config = (((uint32_t)delay) << 16) | (uint32_t)scale;
+		if (!app->pluto.rx_ch[i] || !app->pluto.tx_ch[i]) {
+			fprintf(stderr, "[!] Failed to find channel %s, is the AD9361 in 2RX2TX mode ?\n", name);
+			goto err;
+		}
 
-	iio_device_reg_write(app->pluto.tx, 0x8000043c, config);	/* I combiner config */
-	iio_device_reg_write(app->pluto.tx, 0x8000047c, config);	/* Q combiner config */
+		iio_channel_enable(app->pluto.rx_ch[i]);
+		iio_channel_enable(app->pluto.tx_ch[i]);
+	}
 
 	return 0;
 
@@ -187,20 +349,132 @@ err:
 	return -1;
 }
 
+static unsigned int
+app_ddr_size(struct app_options *opts)
+{
+	/* The DDR buffer is split evenly between the paths */
+	return opts->ddr_size / opts->n_chan;
+}
+
 static void
-app_pluto_close(struct app_state *app)
+app_pluto_config(struct app_state *app, int pair)
 {
-	if (app->pluto.rx_i)
-		iio_channel_disable(app->pluto.rx_i);
+	/* Configure the ECHO path */
+	struct app_echo *echo = &app->opts.echo[pair];
+	uint16_t scale = (uint16_t)(int16_t)(0x4000 * echo->scale);
+	uint32_t ctrl = 0;
+
+	if (echo->delay > RFLB_BRAM_MAX_DELAY)
+		ctrl |= RFLB_CTRL_LONG;
+
+	if (echo->delay_frac || (echo->speed != 0.0f))
+		ctrl |= RFLB_CTRL_FRAC;
+
+	/* Frequency in turns per sample * 2^32, phase in turns * 2^16 */
+	double nco_freq  = (double)echo->doppler / (double)app->opts.samp_rate * 4294967296.0;
+	double nco_phase = (double)echo->phase / 360.0 * 65536.0;
+
+	if ((echo->doppler != 0.0f) || (echo->phase != 0.0f))
+		ctrl |= RFLB_CTRL_NCO;
+
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DELAY), echo->delay);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DELAY_FRAC), echo->delay_frac);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_SCALE), scale);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DDR_BASE),
+		app->opts.ddr_base + pair * app_ddr_size(&app->opts));
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DDR_SIZE), app_ddr_size(&app->opts));
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_NCO_FREQ),
+		(uint32_t)(int32_t)(nco_freq + (nco_freq < 0 ? -0.5 : 0.5)));
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_NCO_PHASE),
+		(uint16_t)(long long)(nco_phase + (nco_phase < 0 ? -0.5 : 0.5)));
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_NOISE_LEVEL), echo->noise_level);
+
+	/* Fading, unit mean power split between line of sight and diffuse */
+	if (echo->fading != 0.0f) {
+		double k = pow(10.0, echo->rician_k / 10.0);
+		double fade_doppler = (double)echo->fading / (double)app->opts.samp_rate * 4294967296.0;
+		uint16_t los = (uint16_t)(0x4000 * sqrt(k / (k + 1.0)) + 0.5);
+		uint16_t diffuse = (uint16_t)(0x4000 * sqrt(1.0 / (k + 1.0)) + 0.5);
+
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_FADE_DOPPLER), (uint32_t)(fade_doppler + 0.5));
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_FADE_GAIN), ((uint32_t)diffuse << 16) | los);
+
+		ctrl |= RFLB_CTRL_FADE;
+	}
+
+	/* TDMA slots, slots past the given ones are muted */
+	if (echo->n_slots) {
+		double tdma_step = 4294967296.0 / (GSM_FRAME_PERIOD * (double)app->opts.samp_rate);
+		double tdma_offset = fmod((double)echo->tdma_offset * 1e-6 / GSM_FRAME_PERIOD, 1.0);
+
+		if (tdma_offset < 0.0)
+			tdma_offset += 1.0;
+
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TDMA_STEP), (uint32_t)(tdma_step + 0.5));
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TDMA_OFFSET),
+			(uint32_t)(long long)(tdma_offset * 4294967296.0 + 0.5));
+
+		for (int s=0; s<RFLB_N_SLOTS; s++) {
+			uint32_t entry = 0;
+
+			if ((s < echo->n_slots) && echo->slots[s].gate)
+				entry = RFLB_SLOT_GATE |
+					((uint32_t)echo->slots[s].samples << 16) |
+					(uint16_t)(int16_t)(0x4000 * echo->slots[s].scale);
+
+			iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_SLOT(s)), entry);
+		}
+
+		ctrl |= RFLB_CTRL_TDMA;
+	}
+
+	/* Delay ramp, in samples per sample * 2^32, from the echo delay */
+	if (echo->speed != 0.0f) {
+		double ramp_rate = (double)echo->speed / SPEED_OF_LIGHT * 4294967296.0;
+
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_RAMP_RATE),
+			(uint32_t)(int32_t)(ramp_rate + (ramp_rate < 0 ? -0.5 : 0.5)));
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_RAMP_BOUNDS),
+			((uint32_t)echo->ramp_bound[1] << 16) | echo->ramp_bound[0]);
+
+		ctrl |= RFLB_CTRL_RAMP;
+		if (echo->pingpong)
+			ctrl |= RFLB_CTRL_PINGPONG;
+	}
+
+	for (int k=1; k<RFLB_N_TAPS; k++) {
+		int tap_delay = 0;
+		uint16_t tap_scale = 0;	/* Unused taps are muted */
+
+		if (k <= echo->n_taps) {
+			tap_delay = echo->taps[k-1].delay;
+			tap_scale = (uint16_t)(int16_t)(0x4000 * echo->taps[k-1].scale);
+		}
+
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TAP_DELAY(k)), tap_delay);
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TAP_SCALE(k)), tap_scale);
+	}
+
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_CTRL), ctrl);	/* Commits config */
+}
 
-	if (app->pluto.rx_q)
-		iio_channel_disable(app->pluto.rx_q);
+static void
+app_pluto_mux(struct app_state *app, int pair, uint32_t sel)
+{
+	iio_device_reg_write(app->pluto.tx, DAC_CHAN_SEL(2 * pair + 0), sel);	/* I mux */
+	iio_device_reg_write(app->pluto.tx, DAC_CHAN_SEL(2 * pair + 1), sel);	/* Q mux */
+}
 
-	if (app->pluto.tx_i)
-		iio_channel_disable(app->pluto.tx_i);
+static void
+app_pluto_close(struct app_state *app)
+{
+	for (int i=0; i<2*RFLB_N_PAIRS; i++) {
+		if (app->pluto.rx_ch[i])
+			iio_channel_disable(app->pluto.rx_ch[i]);
 
-	if (app->pluto.tx_q)
-		iio_channel_disable(app->pluto.tx_q);
+		if (app->pluto.tx_ch[i])
+			iio_channel_disable(app->pluto.tx_ch[i]);
+	}
 
 	if (app->pluto.ctx)
 		iio_context_destroy(app->pluto.ctx);
@@ -208,6 +482,81 @@ app_pluto_close(struct app_state *app)
 	memset(&app->pluto, 0x00, sizeof(app->pluto));
 }
 
+static double
+peak_dbfs(uint32_t peak)
+{
+	return 20.0 * log10((double)peak / RFLB_FULL_SCALE);
+}
+
+static double
+power_dbfs(uint32_t power)
+{
+	return 10.0 * log10((double)power / (RFLB_FULL_SCALE * RFLB_FULL_SCALE));
+}
+
+static void
+app_pluto_stats(struct app_state *app, int pair)
+{
+	static int first[RFLB_N_PAIRS] = { 1, 1 };
+	static uint32_t valid_prev[RFLB_N_PAIRS];
+	static uint32_t sat_prev[RFLB_N_PAIRS];
+	uint32_t stats[RFLB_STAT_COUNT];
+
+	/* Those are refreshed once per window (2^20 samples) */
+	for (int i=0; i<RFLB_STAT_COUNT; i++)
+		if (iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_STATS + i), &stats[i]))
+			return;
+
+	if (!first[pair] && (stats[RFLB_STAT_VALID] == valid_prev[pair]))
+		return;
+
+	if (!first[pair] && (stats[RFLB_STAT_SAT] != sat_prev[pair]))
+		fprintf(stderr, "[!] Channel %d : %u saturated samples, amplitude too high ?\n",
+			pair, stats[RFLB_STAT_SAT] - sat_prev[pair]);
+
+	if (app->opts.stats)
+		fprintf(stderr, "[.] Ch %d | RX peak %5.1f / %5.1f dBFS, power %5.1f / %5.1f dBFS | "
+				"TX peak %5.1f / %5.1f dBFS, power %5.1f / %5.1f dBFS | %u samples\n",
+			pair,
+			peak_dbfs(stats[RFLB_STAT_RX_PEAK] & 0xffff),
+			peak_dbfs(stats[RFLB_STAT_RX_PEAK] >> 16),
+			power_dbfs(stats[RFLB_STAT_RX_POWER_I]),
+			power_dbfs(stats[RFLB_STAT_RX_POWER_Q]),
+			peak_dbfs(stats[RFLB_STAT_TX_PEAK] & 0xffff),
+			peak_dbfs(stats[RFLB_STAT_TX_PEAK] >> 16),
+			power_dbfs(stats[RFLB_STAT_TX_POWER_I]),
+			power_dbfs(stats[RFLB_STAT_TX_POWER_Q]),
+			stats[RFLB_STAT_VALID] - valid_prev[pair]
+		);
+
+	first[pair] = 0;
+	valid_prev[pair] = stats[RFLB_STAT_VALID];
+	sat_prev[pair] = stats[RFLB_STAT_SAT];
+}
+
+static void
+app_pluto_check(struct app_state *app)
+{
+	static uint32_t status_prev[RFLB_N_PAIRS];
+	uint32_t status;
+
+	for (int p=0; p<app->opts.n_chan; p++)
+	{
+		app_pluto_stats(app, p);
+
+		if (iio_device_reg_read(app->pluto.tx, RFLB_REG(p, RFLB_STATUS), &status))
+			continue;
+
+		if ((status & RFLB_STATUS_UNDERFLOW) && !(status_prev[p] & RFLB_STATUS_UNDERFLOW))
+			fprintf(stderr, "[!] Channel %d : Long delay underflow, delay too short for DDR mode ?\n", p);
+
+		if ((status & RFLB_STATUS_OVERFLOW) && !(status_prev[p] & RFLB_STATUS_OVERFLOW))
+			fprintf(stderr, "[!] Channel %d : Long delay overflow, delay too long for the DDR buffer ?\n", p);
+
+		status_prev[p] = status;
+	}
+}
+
 static int
 app_pluto_start(struct app_state *app)
 {
@@ -226,9 +575,157 @@ app_pluto_start(struct app_state *app)
 		return -1;
 	}
 
-	/* Echo start */
-	iio_device_reg_write(app->pluto.tx, 0x80000418, 0xa);		/* I mux to RF loopback */
-	iio_device_reg_write(app->pluto.tx, 0x80000458, 0xa);		/* Q mux to RF loopback */
+	/* Silent until the echo config is committed, the registers may
+	 * still hold a previous run one */
+	for (int p=0; p<app->opts.n_chan; p++)
+		app_pluto_mux(app, p, DAC_SEL_ZERO);
+
+	return 0;
+}
+
+static void
+app_pluto_pump(struct app_state *app)
+{
+	uint8_t *start = iio_buffer_start(app->pluto.tx_buf);
+	uint8_t *end   = iio_buffer_end(app->pluto.tx_buf);
+
+	memset(start, 0x00, end - start);
+	iio_buffer_push(app->pluto.tx_buf);
+	iio_buffer_refill(app->pluto.rx_buf);
+}
+
+static int
+app_pluto_probe(struct app_state *app, int pair)
+{
+	struct iio_channel *rx_lo = iio_device_find_channel(app->pluto.phy, "altvoltage0", true);
+	struct app_echo *echo = &app->opts.echo[pair];
+	uint32_t ctrl = 0, result;
+	int i, rv = -1;
+
+	fprintf(stderr, "[+] Measuring the channel %d round trip latency, TX%d must be coupled to RX%d ...\n",
+		pair, pair + 1, pair + 1);
+
+	/* RX on the TX frequency, echo path without delay nor effects */
+	iio_channel_attr_write_longlong(rx_lo, "frequency", app->opts.tx_freq);
+
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DELAY), 0);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_DELAY_FRAC), 0);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_SCALE),
+		(uint16_t)(int16_t)(0x4000 * echo->scale));
+	for (int k=1; k<RFLB_N_TAPS; k++)
+		iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TAP_SCALE(k)), 0);
+
+	/* No noise (not covered by CTRL), no leftover ramp nor TDMA schedule */
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_NOISE_LEVEL), 0);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_RAMP_RATE), 0);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TDMA_STEP), 0);
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_TDMA_OFFSET), 0);
+
+	/* Commits all the above, ramp, TDMA, NCO and fading disabled */
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_CTRL), 0);
+
+	/* The probe goes through the full echo, whatever the selected mux */
+	app_pluto_mux(app, pair, DAC_SEL_RFLB);
+
+	/* Let the LO settle */
+	for (i=0; i<256; i++)
+		app_pluto_pump(app);
+
+	/* Run it */
+	iio_device_reg_write(app->pluto.tx, RFLB_REG(pair, RFLB_PROBE_CTRL), RFLB_PROBE_START);
+
+	for (i=0; i<4096; i++) {
+		app_pluto_pump(app);
+
+		if (iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_PROBE_CTRL), &ctrl))
+			goto done;
+
+		if ((ctrl & RFLB_PROBE_DONE) && !(ctrl & RFLB_PROBE_BUSY))
+			break;
+	}
+
+	if (!(ctrl & RFLB_PROBE_DONE)) {
+		fprintf(stderr, "[!] Latency probe timed out\n");
+		goto done;
+	}
+
+	if (iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_PROBE_RESULT), &result))
+		goto done;
+
+	if ((result >> 16) < RFLB_PROBE_MIN_PEAK) {
+		fprintf(stderr, "[!] Latency probe sequence not received (peak %u), is TX%d coupled to RX%d ?\n",
+			result >> 16, pair + 1, pair + 1);
+		goto done;
+	}
+
+	echo->latency = (double)(result & 0xffff);
+	fprintf(stderr, "[+] Channel %d round trip latency : %u samples, %.3f us (peak %u)\n",
+		pair, result & 0xffff, echo->latency / (double)app->opts.samp_rate * 1e6, result >> 16);
+	rv = 0;
+
+done:
+	/* Back to the real RX frequency, silent until configured */
+	iio_channel_attr_write_longlong(rx_lo, "frequency", app->opts.rx_freq);
+	app_pluto_mux(app, pair, DAC_SEL_ZERO);
+
+	return rv;
+}
+
+static int
+noise_level(double sigma)
+{
+	double l = sigma / RFLB_NOISE_SIGMA + 0.5;
+	return l > RFLB_NOISE_MAX_LEVEL ? RFLB_NOISE_MAX_LEVEL : (int)l;
+}
+
+static int
+app_pluto_snr(struct app_state *app, int pair)
+{
+	struct app_echo *echo = &app->opts.echo[pair];
+	uint32_t valid, valid_first = 0;
+	uint32_t power_i, power_q;
+	double p_rx, gain, sigma;
+	int i, n = 0;
+
+	/* Wait for a complete statistics window of RX samples */
+	for (i=0; i<4096; i++) {
+		app_pluto_pump(app);
+
+		if (iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_STATS + RFLB_STAT_VALID), &valid))
+			return -1;
+
+		if (!n || (valid != valid_first)) {
+			valid_first = valid;
+			if (++n == 3)
+				break;
+		}
+	}
+
+	if ((n < 3) ||
+	    iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_STATS + RFLB_STAT_RX_POWER_I), &power_i) ||
+	    iio_device_reg_read(app->pluto.tx, RFLB_REG(pair, RFLB_STATS + RFLB_STAT_RX_POWER_Q), &power_q)) {
+		fprintf(stderr, "[!] Channel %d : No RX power measurement\n", pair);
+		return -1;
+	}
+
+	/* Echo power, the taps being uncorrelated */
+	gain = echo->scale * echo->scale;
+	for (int k=0; k<echo->n_taps; k++)
+		gain += echo->taps[k].scale * echo->taps[k].scale;
+
+	p_rx = (double)power_i + (double)power_q;
+	if ((p_rx == 0.0) || (gain == 0.0)) {
+		fprintf(stderr, "[!] Channel %d : No echo signal, can't set the SNR\n", pair);
+		return -1;
+	}
+
+	/* Complex SNR : (P_I + P_Q) / (2 * sigma^2) */
+	sigma = sqrt(p_rx * gain / (2.0 * pow(10.0, echo->snr / 10.0)));
+	echo->noise_level = noise_level(sigma);
+
+	fprintf(stderr, "[+] Channel %d noise : RX %.1f dBFS, echo %.1f dBFS, noise %.1f dBFS per rail%s\n",
+		pair, power_dbfs(p_rx / 2.0), power_dbfs(p_rx * gain / 2.0), power_dbfs(sigma * sigma),
+		echo->noise_level == RFLB_NOISE_MAX_LEVEL ? " (max)" : "");
 
 	return 0;
 }
@@ -243,8 +740,8 @@ app_pluto_stop(struct app_state *app)
 		iio_buffer_destroy(app->pluto.tx_buf);
 
 	/* Force zero */
-	iio_device_reg_write(app->pluto.tx, 0x80000418, 0);		/* I mux to zero */
-	iio_device_reg_write(app->pluto.tx, 0x80000458, 0);		/* Q mux to zero */
+	for (int p=0; p<app->opts.n_chan; p++)
+		app_pluto_mux(app, p, 0);
 }
 
 
@@ -252,6 +749,18 @@ app_pluto_stop(struct app_state *app)
 /* Options                                                                  */
 /* ------------------------------------------------------------------------ */
 
+/* Echo path outputs that can be sent to TX */
+static const struct {
+	const char *name;
+	int sel;
+} opts_muxes[] = {
+	{ "echo",  DAC_SEL_RFLB },		/* Full echo, with taps and effects */
+	{ "delay", DAC_SEL_RFLB_DLY },	/* Delay line output only */
+	{ "rx",    DAC_SEL_RX },			/* RX samples, no delay */
+	{ "zero",  DAC_SEL_ZERO },
+	{ NULL,    0 }
+};
+
 static void
 opts_defaults(struct app_options *opts)
 {
@@ -267,8 +776,402 @@ opts_defaults(struct app_options *opts)
 	opts->buf_cnt = 4;
 	opts->buf_size = 4096;
 
-	opts->echo_scale = 0.25f;
-	opts->echo_delay = 50;
+	for (int p=0; p<RFLB_N_PAIRS; p++) {
+		opts->echo[p].mux = DAC_SEL_RFLB;
+		opts->echo[p].scale = 0.25f;
+		opts->echo[p].delay = 50;
+		opts->echo[p].delay_time = -1.0;
+		opts->echo[p].gain = 1.0;
+		opts->echo[p].noise = NAN;
+		opts->echo[p].snr = NAN;
+		opts->echo[p].rician_k = -INFINITY;
+		opts->echo[p].ramp_time[0] = -1.0;
+		opts->echo[p].ramp_time[1] = -1.0;
+		opts->echo[p].ramp_bound[0] = RFLB_FRAC_MIN_DELAY;
+		opts->echo[p].ramp_bound[1] = RFLB_BRAM_MAX_DELAY;
+	}
+	opts->n_chan = 1;
+
+	opts->ddr_base = 0x1c000000;	/* Top 64 MiB of the 512 MiB DDR */
+	opts->ddr_size = 0x04000000;
+}
+
+static void
+opts_set_delay(struct app_echo *echo, double d)
+{
+	echo->delay = (int)d;
+	echo->delay_frac = (int)((d - echo->delay) * 65536.0 + 0.5);
+
+	if (echo->delay_frac == 65536) {
+		echo->delay++;
+		echo->delay_frac = 0;
+	}
+}
+
+static int
+opts_parse_unit(const char *suffix, int len, double *unit)
+{
+	static const struct {
+		const char *suffix;
+		double unit;
+	} units[] = {
+		{ "s",   1.0 },
+		{ "ms",  1e-3 },
+		{ "us",  1e-6 },
+		{ "ns",  1e-9 },
+		{ "bit", GSM_BIT_PERIOD },
+		{ NULL,  0.0 }
+	};
+
+	for (int i=0; units[i].suffix; i++) {
+		if ((strlen(units[i].suffix) == len) && !strncasecmp(suffix, units[i].suffix, len)) {
+			*unit = units[i].unit;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "[!] Invalid delay unit '%.*s' (s, ms, us, ns or bit)\n", len, suffix);
+	return -1;
+}
+
+static int
+opts_parse_delay(struct app_echo *echo, const char *arg)
+{
+	double d, unit;
+	char *e;
+
+	d = strtod(arg, &e);
+	if ((e == arg) || (d < 0.0)) {
+		fprintf(stderr, "[!] Invalid delay '%s'\n", arg);
+		return -1;
+	}
+
+	/* Samples, possibly with a fractional part */
+	if (*e == '\0') {
+		if (d >= 2147483647.0) {
+			fprintf(stderr, "[!] Invalid delay '%s'\n", arg);
+			return -1;
+		}
+
+		opts_set_delay(echo, d);
+		echo->delay_time = -1.0;
+		return 0;
+	}
+
+	/* Time, converted once the sample rate and latency are known */
+	if (opts_parse_unit(e, strlen(e), &unit))
+		return -1;
+
+	echo->delay_time = d * unit;
+	return 0;
+}
+
+static int
+opts_parse_bounds(struct app_echo *echo, const char *arg)
+{
+	const char *p = arg;
+	double d, unit;
+	char *e;
+
+	/* min:max, each in samples or with a time unit like --delay */
+	for (int i=0; i<2; i++) {
+		const char *end;
+
+		d = strtod(p, &e);
+		if ((e == p) || (d < 0.0))
+			goto err;
+
+		end = i ? (e + strlen(e)) : strchr(e, ':');
+		if (!end)
+			goto err;
+
+		if (end == e) {
+			if (d > 65535.0)
+				goto err;
+			echo->ramp_bound[i] = (int)(d + 0.5);
+			echo->ramp_time[i] = -1.0;
+		} else {
+			if (opts_parse_unit(e, end - e, &unit))
+				return -1;
+			echo->ramp_time[i] = d * unit;
+		}
+
+		p = end + 1;
+	}
+
+	return 0;
+
+err:
+	fprintf(stderr, "[!] Invalid ramp bounds '%s', expected min:max\n", arg);
+	return -1;
+}
+
+static int
+opts_resolve_delay(struct app_options *opts, int pair)
+{
+	struct app_echo *echo = &opts->echo[pair];
+	unsigned int ddr_size = app_ddr_size(opts);
+	double d;
+
+	/* Delays in time units are the total, fixed latency included */
+	if (echo->delay_time >= 0.0) {
+		d = echo->delay_time * (double)opts->samp_rate / echo->gain - echo->latency;
+
+		if (d < 0.0) {
+			fprintf(stderr, "[!] Channel %d : Delay shorter than the fixed latency (%.1f samples)\n",
+				pair, echo->latency);
+			return -1;
+		}
+
+		if (d >= 2147483647.0) {
+			fprintf(stderr, "[!] Channel %d : Delay too long\n", pair);
+			return -1;
+		}
+
+		opts_set_delay(echo, d);
+
+		fprintf(stderr, "[+] Channel %d echo delay : %.3f us, %.4f samples programmed + %.1f samples latency\n",
+			pair,
+			echo->delay_time * 1e6,
+			echo->delay + echo->delay_frac / 65536.0,
+			echo->latency);
+	}
+
+	/* Ramp bounds in time units are the total too */
+	for (int i=0; i<2; i++) {
+		if (echo->ramp_time[i] < 0.0)
+			continue;
+
+		d = echo->ramp_time[i] * (double)opts->samp_rate / echo->gain - echo->latency;
+		echo->ramp_bound[i] = d < 0.0 ? -1 : (d > 65535.0 ? 65536 : (int)(d + 0.5));
+	}
+
+	/* The ramp only moves the BRAM delay line, with the fractional delay
+	 * filter on, starting from the echo delay */
+	if (echo->speed != 0.0f) {
+		if ((echo->ramp_bound[0] < RFLB_FRAC_MIN_DELAY) ||
+		    (echo->ramp_bound[1] > RFLB_BRAM_MAX_DELAY) ||
+		    (echo->ramp_bound[0] > echo->ramp_bound[1])) {
+			fprintf(stderr, "[!] Channel %d : Ramp bounds must be within %d - %d samples\n",
+				pair, RFLB_FRAC_MIN_DELAY, RFLB_BRAM_MAX_DELAY);
+			return -1;
+		}
+
+		if ((echo->delay < echo->ramp_bound[0]) || (echo->delay >= echo->ramp_bound[1])) {
+			fprintf(stderr, "[!] Channel %d : Echo delay must be within the ramp bounds\n", pair);
+			return -1;
+		}
+	}
+
+	if (echo->delay_frac && (echo->delay < RFLB_FRAC_MIN_DELAY)) {
+		fprintf(stderr, "[!] Fractional delays must be at least %d samples\n", RFLB_FRAC_MIN_DELAY);
+		return -1;
+	}
+
+	if ((echo->delay > RFLB_BRAM_MAX_DELAY) &&
+	    ((ddr_size & (ddr_size - 1)) || (echo->delay >= (ddr_size / 4) - 1024))) {
+		fprintf(stderr, "[!] DDR buffer size must be a power of two and large enough for the delay\n");
+		return -1;
+	}
+
+	/* TDMA slot delays add to the echo one, in the BRAM delay line only */
+	int max_delay = (echo->speed != 0.0f) ? echo->ramp_bound[1] : echo->delay;
+
+	for (int s=0; s<echo->n_slots; s++) {
+		d = echo->slots[s].delay;
+		if (echo->slots[s].bits)
+			d *= GSM_BIT_PERIOD * (double)opts->samp_rate;
+		echo->slots[s].samples = (int)(d + 0.5);
+
+		if (!echo->slots[s].gate)
+			continue;
+
+		if ((echo->slots[s].samples > RFLB_SLOT_MAX_DELAY) ||
+		    (max_delay + echo->slots[s].samples > RFLB_BRAM_MAX_DELAY)) {
+			fprintf(stderr, "[!] Channel %d : Slot %d delay out of range, the total must be at most %d samples\n",
+				pair, s, RFLB_BRAM_MAX_DELAY);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Calibration table, as written by utils/rfds-calib : one line per
+ * measured setup, '#' comments,
+ *
+ *   pinger_rate pinger_mcr rfds_rate offset gain rfds_latency pinger_latency rms max
+ *
+ * For our sample rate, the latency (unless given) and the gain are
+ * averaged over the entries for all the pinger setups.
+ */
+static int
+opts_load_calib(struct app_options *opts)
+{
+	double v[9], lat_sum = 0.0, gain_sum = 0.0;
+	int n_lat = 0, n_gain = 0;
+	char line[256];
+	FILE *fh;
+
+	fh = fopen(opts->calib, "r");
+	if (!fh) {
+		fprintf(stderr, "[!] Failed to open calibration table '%s'\n", opts->calib);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fh))
+	{
+		if ((line[0] == '#') || (line[0] == '\n'))
+			continue;
+
+		if (sscanf(line, "%lf %lf %lf %lf %lf %lf %lf %lf %lf",
+			   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) != 9) {
+			fprintf(stderr, "[!] Invalid calibration table line : %s", line);
+			continue;
+		}
+
+		if (fabs(v[2] - (double)opts->samp_rate) >= 1.0)
+			continue;
+
+		gain_sum += v[4];
+		n_gain++;
+
+		/* No latency if the probe didn't work during the calibration */
+		if (!isnan(v[5])) {
+			lat_sum += v[5];
+			n_lat++;
+		}
+	}
+
+	fclose(fh);
+
+	if (!n_gain) {
+		fprintf(stderr, "[!] No calibration for %lld sps in '%s'\n", opts->samp_rate, opts->calib);
+		return -1;
+	}
+
+	for (int p=0; p<RFLB_N_PAIRS; p++) {
+		opts->echo[p].gain = gain_sum / n_gain;
+		if (n_lat && !opts->echo[p].latency_set)
+			opts->echo[p].latency = lat_sum / n_lat;
+	}
+
+	fprintf(stderr, "[+] Calibration : gain %.6f, latency %.2f samples%s\n",
+		opts->echo[0].gain, opts->echo[0].latency,
+		opts->echo[0].latency_set ? " (given)" : "");
+
+	return 0;
+}
+
+static int
+opts_check_scale(float scale)
+{
+	/* Signed Q2.14 in the FPGA, 2.0 doesn't fit */
+	if (!(fabsf(scale) < 2.0f)) {
+		fprintf(stderr, "[!] Invalid amplitude %.3f, must be between -2.0 and 2.0 (excluded)\n", scale);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+opts_parse_taps(struct app_echo *echo, const char *arg)
+{
+	const char *p = arg;
+	char *e;
+
+	/* List of delay:amplitude, comma separated */
+	echo->n_taps = 0;
+
+	while (*p) {
+		if (echo->n_taps == RFLB_N_TAPS - 1) {
+			fprintf(stderr, "[!] At most %d extra taps\n", RFLB_N_TAPS - 1);
+			return -1;
+		}
+
+		echo->taps[echo->n_taps].delay = strtol(p, &e, 10);
+		if ((e == p) || (*e != ':'))
+			goto err;
+		p = e + 1;
+
+		echo->taps[echo->n_taps].scale = strtof(p, &e);
+		if ((e == p) || ((*e != ',') && (*e != '\0')))
+			goto err;
+		p = (*e == ',') ? e + 1 : e;
+
+		if (opts_check_scale(echo->taps[echo->n_taps].scale))
+			return -1;
+
+		if ((echo->taps[echo->n_taps].delay < 0) ||
+		    (echo->taps[echo->n_taps].delay > RFLB_TAP_MAX_DELAY)) {
+			fprintf(stderr, "[!] Tap delay must be between 0 and %d samples\n", RFLB_TAP_MAX_DELAY);
+			return -1;
+		}
+
+		echo->n_taps++;
+	}
+
+	return 0;
+
+err:
+	fprintf(stderr, "[!] Invalid taps list '%s', expected delay:amplitude[,...]\n", arg);
+	return -1;
+}
+
+static int
+opts_parse_slots(struct app_echo *echo, const char *arg)
+{
+	const char *p = arg;
+	char *e;
+
+	/* List of delay[bit]:amplitude or off, comma separated, from slot 0 */
+	echo->n_slots = 0;
+
+	while (*p) {
+		int s = echo->n_slots;
+
+		if (s == RFLB_N_SLOTS) {
+			fprintf(stderr, "[!] At most %d slots\n", RFLB_N_SLOTS);
+			return -1;
+		}
+
+		if (!strncasecmp(p, "off", 3) && ((p[3] == ',') || (p[3] == '\0'))) {
+			echo->slots[s].gate = 0;
+			p += (p[3] == ',') ? 4 : 3;
+			echo->n_slots++;
+			continue;
+		}
+
+		echo->slots[s].gate = 1;
+
+		echo->slots[s].delay = strtof(p, &e);
+		if ((e == p) || (echo->slots[s].delay < 0.0f))
+			goto err;
+		echo->slots[s].bits = !strncasecmp(e, "bit", 3);
+		if (echo->slots[s].bits)
+			e += 3;
+		if (*e != ':')
+			goto err;
+		p = e + 1;
+
+		echo->slots[s].scale = strtof(p, &e);
+		if ((e == p) || ((*e != ',') && (*e != '\0')))
+			goto err;
+		p = (*e == ',') ? e + 1 : e;
+
+		if (opts_check_scale(echo->slots[s].scale))
+			return -1;
+
+		echo->n_slots++;
+	}
+
+	return 0;
+
+err:
+	fprintf(stderr, "[!] Invalid slots list '%s', expected delay[bit]:amplitude or off[,...]\n", arg);
+	return -1;
 }
 
 static void
@@ -285,6 +1188,26 @@ opts_help(const char *argv0)
 	fprintf(stderr, " -b, --buffer-size  \n");
 	fprintf(stderr, " -a, --amplitude    \n");
 	fprintf(stderr, " -d, --delay        \n");
+	fprintf(stderr, " -D, --ddr-base     \n");
+	fprintf(stderr, " -S, --ddr-size     \n");
+	fprintf(stderr, " -m, --taps         \n");
+	fprintf(stderr, " -f, --doppler      \n");
+	fprintf(stderr, " -P, --phase        \n");
+	fprintf(stderr, " -v, --stats        \n");
+	fprintf(stderr, " -l, --latency      \n");
+	fprintf(stderr, " -L, --probe        \n");
+	fprintf(stderr, " -C, --channel      \n");
+	fprintf(stderr, " -x, --mux          \n");
+	fprintf(stderr, " -n, --noise        \n");
+	fprintf(stderr, " -N, --snr          \n");
+	fprintf(stderr, " -F, --fading       \n");
+	fprintf(stderr, " -K, --rician-k     \n");
+	fprintf(stderr, " -g, --slots        \n");
+	fprintf(stderr, " -o, --tdma-offset  \n");
+	fprintf(stderr, " -V, --speed        \n");
+	fprintf(stderr, " -B, --bounds       \n");
+	fprintf(stderr, " -p, --ping-pong    \n");
+	fprintf(stderr, " -k, --calib        \n");
 	fprintf(stderr, " -h, --help         \n");
 }
 
@@ -302,10 +1225,31 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 		{ "buffer-size",  required_argument, 0, 'b' },
 		{ "amplitude",    required_argument, 0, 'a' },
 		{ "delay",        required_argument, 0, 'd' },
+		{ "ddr-base",     required_argument, 0, 'D' },
+		{ "ddr-size",     required_argument, 0, 'S' },
+		{ "taps",         required_argument, 0, 'm' },
+		{ "doppler",      required_argument, 0, 'f' },
+		{ "phase",        required_argument, 0, 'P' },
+		{ "stats",        no_argument,       0, 'v' },
+		{ "latency",      required_argument, 0, 'l' },
+		{ "probe",        no_argument,       0, 'L' },
+		{ "channel",      required_argument, 0, 'C' },
+		{ "mux",          required_argument, 0, 'x' },
+		{ "noise",        required_argument, 0, 'n' },
+		{ "snr",          required_argument, 0, 'N' },
+		{ "fading",       required_argument, 0, 'F' },
+		{ "rician-k",     required_argument, 0, 'K' },
+		{ "slots",        required_argument, 0, 'g' },
+		{ "tdma-offset",  required_argument, 0, 'o' },
+		{ "speed",        required_argument, 0, 'V' },
+		{ "bounds",       required_argument, 0, 'B' },
+		{ "ping-pong",    no_argument,       0, 'p' },
+		{ "calib",        required_argument, 0, 'k' },
 		{ "help",         no_argument,       0, 'h' },
 		{0, 0, 0, 0}
 	};
-	const char *short_options = "t:r:T:R:s:c:b:a:d:h";
+	struct app_echo *echo = &opts->echo[0];
+	const char *short_options = "t:r:T:R:s:c:b:a:d:D:S:m:f:P:vl:LC:x:n:N:F:K:g:o:V:B:pk:h";
 
 	while (1) {
 		int optidx;
@@ -344,13 +1288,118 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 			break;
 
 		case 'a':
-			opts->echo_scale = strtof(optarg, NULL);
+			echo->scale = strtof(optarg, NULL);
+			if (opts_check_scale(echo->scale))
+				return -1;
 			break;
 
 		case 'd':
-			opts->echo_delay = strtol(optarg, NULL, 10);
+			if (opts_parse_delay(echo, optarg))
+				return -1;
+			break;
+
+		case 'D':
+			opts->ddr_base = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'S':
+			opts->ddr_size = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'm':
+			if (opts_parse_taps(echo, optarg))
+				return -1;
+			break;
+
+		case 'f':
+			echo->doppler = strtof(optarg, NULL);
+			break;
+
+		case 'P':
+			echo->phase = strtof(optarg, NULL);
+			break;
+
+		case 'v':
+			opts->stats = 1;
+			break;
+
+		case 'l':
+			echo->latency = strtod(optarg, NULL);
+			echo->latency_set = 1;
+			break;
+
+		case 'L':
+			opts->probe = 1;
+			break;
+
+		case 'C': {
+			/* Following echo options apply to that channel */
+			int p = strtol(optarg, NULL, 10);
+			if ((p < 0) || (p >= RFLB_N_PAIRS)) {
+				fprintf(stderr, "[!] Channel must be between 0 and %d\n", RFLB_N_PAIRS - 1);
+				return -1;
+			}
+			echo = &opts->echo[p];
+			if (p >= opts->n_chan)
+				opts->n_chan = p + 1;
+			break;
+		}
+
+		case 'n':
+			echo->noise = strtof(optarg, NULL);
+			break;
+
+		case 'N':
+			echo->snr = strtof(optarg, NULL);
+			break;
+
+		case 'F':
+			echo->fading = strtof(optarg, NULL);
+			break;
+
+		case 'K':
+			echo->rician_k = strtof(optarg, NULL);
+			break;
+
+		case 'g':
+			if (opts_parse_slots(echo, optarg))
+				return -1;
+			break;
+
+		case 'o':
+			echo->tdma_offset = strtof(optarg, NULL);
+			break;
+
+		case 'V':
+			echo->speed = strtof(optarg, NULL);
 			break;
 
+		case 'B':
+			if (opts_parse_bounds(echo, optarg))
+				return -1;
+			break;
+
+		case 'p':
+			echo->pingpong = 1;
+			break;
+
+		case 'k':
+			opts->calib = optarg;
+			break;
+
+		case 'x': {
+			int i;
+			for (i=0; opts_muxes[i].name; i++)
+				if (!strcasecmp(optarg, opts_muxes[i].name))
+					break;
+			if (!opts_muxes[i].name) {
+				fprintf(stderr, "[!] Invalid mux '%s' (echo, delay, rx or zero)\n", optarg);
+				return -1;
+			}
+			echo->mux = opts_muxes[i].sel;
+			break;
+		}
+
 		case 'h':
 			opts_help(argv[0]);
 			return 1;
@@ -361,6 +1410,37 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 		}
 	}
 
+	/* Now that the sample rate is known */
+	if (opts->calib && opts_load_calib(opts))
+		return -1;
+
+	for (int p=0; p<opts->n_chan; p++) {
+		if ((opts->echo[p].doppler <= -(float)opts->samp_rate / 2) ||
+		    (opts->echo[p].doppler >=  (float)opts->samp_rate / 2)) {
+			fprintf(stderr, "[!] Doppler shift must be within +- half the sample rate\n");
+			return -1;
+		}
+
+		if ((opts->echo[p].fading < 0.0f) ||
+		    ((double)opts->echo[p].fading / (double)opts->samp_rate * 4294967296.0 > RFLB_FADE_MAX_DOPPLER)) {
+			fprintf(stderr, "[!] Fading Doppler spread must be between 0 and %.1f Hz\n",
+				(double)RFLB_FADE_MAX_DOPPLER / 4294967296.0 * (double)opts->samp_rate);
+			return -1;
+		}
+
+		if (!isnan(opts->echo[p].noise) && !isnan(opts->echo[p].snr)) {
+			fprintf(stderr, "[!] Noise power and SNR can't be both given\n");
+			return -1;
+		}
+
+		if (!isnan(opts->echo[p].noise))
+			opts->echo[p].noise_level = noise_level(RFLB_FULL_SCALE * pow(10.0, opts->echo[p].noise / 20.0));
+
+		/* Without a probe, the delay can already be checked */
+		if (!opts->probe && opts_resolve_delay(opts, p))
+			return -1;
+	}
+
 	return 0;
 }
 
@@ -382,8 +1462,62 @@ opts_print(struct app_options *opts, FILE *fd)
 	fprintf(fd, "  . Buffer size    : %d bytes\n", opts->buf_size);
 	fprintf(fd, "\n");
 
-	fprintf(fd, "  . Echo amplitude : %.1f\n", opts->echo_scale);
-	fprintf(fd, "  . Echo delay     : %d samples\n", opts->echo_delay);
+	for (int p=0; p<opts->n_chan; p++) {
+		struct app_echo *echo = &opts->echo[p];
+
+		if (opts->n_chan > 1)
+			fprintf(fd, "  . Channel %d      : RX%d -> TX%d\n", p, p + 1, p + 1);
+		for (int i=0; opts_muxes[i].name; i++)
+			if ((echo->mux != DAC_SEL_RFLB) && (echo->mux == opts_muxes[i].sel))
+				fprintf(fd, "  . Echo mux       : %s\n", opts_muxes[i].name);
+		fprintf(fd, "  . Echo amplitude : %.1f\n", echo->scale);
+		if (echo->delay_time >= 0.0)
+			fprintf(fd, "  . Echo delay     : %.3f us\n", echo->delay_time * 1e6);
+		else
+			fprintf(fd, "  . Echo delay     : %.4f samples\n", echo->delay + echo->delay_frac / 65536.0);
+		if ((echo->doppler != 0.0f) || (echo->phase != 0.0f)) {
+			fprintf(fd, "  . Echo doppler   : %.1f Hz\n", echo->doppler);
+			fprintf(fd, "  . Echo phase     : %.1f deg\n", echo->phase);
+		}
+		if (echo->fading != 0.0f) {
+			fprintf(fd, "  . Fading spread  : %.1f Hz\n", echo->fading);
+			if (isinf(echo->rician_k))
+				fprintf(fd, "  . Fading         : Rayleigh\n");
+			else
+				fprintf(fd, "  . Fading         : Rician, K = %.1f dB\n", echo->rician_k);
+		}
+		if (!isnan(echo->noise))
+			fprintf(fd, "  . Noise          : %.1f dBFS\n", echo->noise);
+		if (!isnan(echo->snr))
+			fprintf(fd, "  . SNR            : %.1f dB\n", echo->snr);
+		if (echo->latency != 0.0)
+			fprintf(fd, "  . Latency        : %.1f samples\n", echo->latency);
+		if (echo->gain != 1.0)
+			fprintf(fd, "  . Delay gain     : %.6f\n", echo->gain);
+		if (echo->delay > RFLB_BRAM_MAX_DELAY)
+			fprintf(fd, "  . DDR buffer     : 0x%08x - 0x%08x\n",
+				opts->ddr_base + p * app_ddr_size(opts),
+				opts->ddr_base + (p + 1) * app_ddr_size(opts) - 1);
+		for (int k=0; k<echo->n_taps; k++)
+			fprintf(fd, "  . Tap %d          : +%d samples, amplitude %.3f\n",
+				k + 1, echo->taps[k].delay, echo->taps[k].scale);
+		if (echo->n_slots)
+			fprintf(fd, "  . TDMA offset    : %.1f us\n", echo->tdma_offset);
+		if (echo->speed != 0.0f)
+			fprintf(fd, "  . Delay ramp     : %.1f m/s (%.3f samples/s)%s\n",
+				echo->speed, echo->speed / SPEED_OF_LIGHT * (double)opts->samp_rate,
+				echo->pingpong ? ", ping-pong" : "");
+		for (int s=0; s<RFLB_N_SLOTS && echo->n_slots; s++) {
+			if ((s >= echo->n_slots) || !echo->slots[s].gate)
+				fprintf(fd, "  . Slot %d         : off\n", s);
+			else
+				fprintf(fd, "  . Slot %d         : +%.1f %s, amplitude %.3f\n",
+					s, echo->slots[s].delay, echo->slots[s].bits ? "bits" : "samples",
+					echo->slots[s].scale);
+		}
+		if (p < opts->n_chan - 1)
+			fprintf(fd, "\n");
+	}
 	fprintf(fd, "\n");
 }
 
@@ -413,12 +1547,35 @@ int main(int argc, char *argv[])
 	/* Start streaming */
 	app_pluto_start(app);
 
+	/* Measure the fixed latency, then configure the echo */
+	for (int p=0; p<app->opts.n_chan; p++)
+	{
+		if (app->opts.probe) {
+			if (app_pluto_probe(app, p))
+				fprintf(stderr, "[!] Using a latency of %.1f samples\n", app->opts.echo[p].latency);
+
+			if (opts_resolve_delay(&app->opts, p))
+				goto err;
+		}
+
+		/* Noise relative to the echo of what's received */
+		if (!isnan(app->opts.echo[p].snr) && app_pluto_snr(app, p))
+			fprintf(stderr, "[!] Channel %d : Noise disabled\n", p);
+
+		app_pluto_config(app, p);
+	}
+
+	/* Echo start, once all the pairs are configured */
+	for (int p=0; p<app->opts.n_chan; p++)
+		app_pluto_mux(app, p, app->opts.echo[p].mux);
+
 	/* Dummy loop */
-	while (1)
+	for (unsigned int i=0; ; i++)
 	{
-		memset(iio_buffer_start(app->pluto.tx_buf), 0x00, app->opts.buf_size);
-		iio_buffer_push(app->pluto.tx_buf);
-		iio_buffer_refill(app->pluto.rx_buf);
+		app_pluto_pump(app);
+
+		if ((i & 1023) == 0)
+			app_pluto_check(app);
 	}
 
 err:
@@ -0,0 +1,515 @@
+#!/usr/bin/env python3
+#
+# rfds-calib.py
+#
+# Closed loop latency calibration of osmo-rfds with uhd-pinger
+#
+# Programs a grid of echo delays on the pluto, measures each of them with
+# the pinger, for each combination of pinger sample rate / master clock
+# rate and osmo-rfds sample rate, and fits the fixed offset and the
+# linearity. The result is a calibration table both tools load at startup
+# (--calib).
+#
+# The tools are driven through their command line and console output, the
+# pinger locally and osmo-rfds usually through ssh. With --sim, both are
+# replaced by simulated stand-ins so the harness itself can be run (and
+# checked) without any hardware.
+#
+# Copyright (C) 2018  sysmocom - systems for mobile communications GmbH
+#
+
+import argparse
+import math
+import queue
+import random
+import re
+import shlex
+import subprocess
+import sys
+import threading
+import time
+
+
+ECHO_RE    = re.compile(r'^\[\+\] Echo at : (.*)$')
+PEAK_RE    = re.compile(r'(-?[0-9.]+) \(([0-9.eE+-]+)\)')
+RATES_RE   = re.compile(r'Device rates : ([0-9]+) sps, ([0-9]+) Hz master clock')
+LATENCY_RE = re.compile(r'round trip latency : ([0-9]+) samples')
+
+
+def log(msg):
+	print(msg, file=sys.stderr, flush=True)
+
+
+def parse_echo(line):
+	"""Peaks of a pinger '[+] Echo at :' line, as (position, magnitude)"""
+	m = ECHO_RE.match(line.strip())
+	if not m:
+		return None
+	return [ (float(p), float(a)) for p, a in PEAK_RE.findall(m.group(1)) ]
+
+
+# ---------------------------------------------------------------------------
+# Real tools
+# ---------------------------------------------------------------------------
+
+class Reader(threading.Thread):
+	"""Collects the lines of a process stream in a queue"""
+
+	def __init__(self, stream):
+		super().__init__(daemon=True)
+		self.stream = stream
+		self.lines = queue.Queue()
+		self.start()
+
+	def run(self):
+		for line in self.stream:
+			self.lines.put(line)
+
+	def drain(self):
+		while not self.lines.empty():
+			self.lines.get_nowait()
+
+	def get(self, timeout):
+		try:
+			return self.lines.get(timeout=timeout)
+		except queue.Empty:
+			return None
+
+
+def stop_process(proc, timeout=5.0):
+	if proc.poll() is None:
+		proc.terminate()
+		try:
+			proc.wait(timeout)
+		except subprocess.TimeoutExpired:
+			proc.kill()
+			proc.wait()
+
+
+class Pinger:
+	"""uhd-pinger, one instance per sample rate / master clock rate"""
+
+	def __init__(self, args):
+		self.cmd = shlex.split(args.pinger)
+		self.args = args
+		self.proc = None
+
+	def start(self, rate, mcr, max_delay):
+		cmd = self.cmd + [
+			'-t', str(self.args.freq_up), '-r', str(self.args.freq_down),
+			'-s', str(rate), '-d', '%.6f' % max_delay,
+			'-p', '%.6f' % self.args.period,
+		]
+		if mcr:
+			cmd += [ '-m', str(mcr) ]
+		cmd += shlex.split(self.args.pinger_args)
+
+		log('[.] Running : %s' % ' '.join(cmd))
+
+		self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE,
+			stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+			universal_newlines=True)
+		self.reader = Reader(self.proc.stderr)
+
+		# Actual rates, the table is looked up with those
+		deadline = time.time() + 30.0
+
+		while time.time() < deadline:
+			line = self.reader.get(timeout=1.0)
+			if line is None:
+				if self.proc.poll() is not None:
+					raise RuntimeError('pinger exited (%d)' % self.proc.returncode)
+				continue
+			m = RATES_RE.search(line)
+			if m:
+				return int(m.group(1)), int(m.group(2))
+
+		raise RuntimeError('pinger didn\'t report its rates')
+
+	def collect(self, n, discard):
+		"""n echo lines, after dropping anything older than now"""
+		self.reader.drain()
+		res = []
+		skip = discard
+		deadline = time.time() + 5.0 + 2.0 * n * self.args.period
+
+		while (len(res) < n) and (time.time() < deadline):
+			line = self.reader.get(timeout=1.0)
+			if line is None:
+				if self.proc.poll() is not None:
+					raise RuntimeError('pinger exited (%d)' % self.proc.returncode)
+				continue
+			peaks = parse_echo(line)
+			if peaks is None:
+				continue
+			if skip:
+				skip -= 1
+				continue
+			res.append(peaks)
+
+		return res
+
+	def stop(self):
+		if self.proc is None:
+			return
+		try:
+			self.proc.stdin.write('quit\n')
+			self.proc.stdin.flush()
+			self.proc.wait(2.0)
+		except (BrokenPipeError, subprocess.TimeoutExpired):
+			pass
+		stop_process(self.proc)
+		self.proc = None
+
+
+class Rfds:
+	"""osmo-rfds, restarted for each echo setting"""
+
+	def __init__(self, args):
+		self.cmd = shlex.split(args.rfds)
+		self.args = args
+		self.proc = None
+
+	def start(self, rate, delay, probe=False, mute=False):
+		cmd = self.cmd + [
+			'-t', str(self.args.freq_down), '-r', str(self.args.freq_up),
+			'-s', str(rate), '-d', '%.4f' % delay,
+		]
+		if probe:
+			cmd += [ '-L' ]
+		if mute:
+			cmd += [ '-x', 'zero' ]
+		cmd += shlex.split(self.args.rfds_args)
+
+		self.proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL,
+			stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+			universal_newlines=True)
+		self.reader = Reader(self.proc.stderr)
+
+		# Latency probe result, if asked, then let things settle
+		latency = None
+		deadline = time.time() + self.args.settle + (10.0 if probe else 0.0)
+
+		while time.time() < deadline:
+			line = self.reader.get(timeout=0.2)
+			if self.proc.poll() is not None:
+				raise RuntimeError('osmo-rfds exited (%d)' % self.proc.returncode)
+			if line is None:
+				continue
+			m = LATENCY_RE.search(line)
+			if m:
+				latency = float(m.group(1))
+				deadline = min(deadline, time.time() + self.args.settle)
+			elif probe and ('Latency probe' in line):
+				deadline = min(deadline, time.time() + self.args.settle)
+
+		return latency
+
+	def stop(self):
+		if self.proc is None:
+			return
+		stop_process(self.proc)
+		self.proc = None
+
+
+# ---------------------------------------------------------------------------
+# Simulated stand-ins
+# ---------------------------------------------------------------------------
+
+class SimBench:
+	"""What's on the air between the UHD device and the pluto"""
+
+	def __init__(self, seed):
+		self.rng = random.Random(seed)
+
+		# pluto : fixed pipeline latency and a slightly fast clock
+		self.rfds_latency_s = 16.5e-6
+		self.rfds_ppm = 12.0
+
+		# Current echo, None when osmo-rfds isn't running
+		self.echo = None		# (delay in s, amplitude)
+
+	def pinger_latency(self, rate, mcr):
+		# UHD TX / RX timestamps mismatch : a fixed part plus filters
+		# delays that depend on the decimation
+		return 12.3 + 0.6 * (mcr / rate)
+
+
+class SimPinger:
+	"""Stand-in for uhd-pinger on a UHD device"""
+
+	def __init__(self, args, bench):
+		self.args = args
+		self.bench = bench
+
+	def start(self, rate, mcr, max_delay):
+		self.rate = rate
+		self.mcr = mcr or (32000000 if rate > 4e6 else 16000000)
+		self.max_delay = max_delay
+		log('[.] Simulated pinger : %d sps, %d Hz MCR' % (rate, self.mcr))
+		return self.rate, self.mcr
+
+	def collect(self, n, discard):
+		bench = self.bench
+		rng = bench.rng
+		own = bench.pinger_latency(self.rate, self.mcr)
+		res = []
+
+		for i in range(n):
+			# Direct TX to RX leak, and the echo, 1/4 sample of jitter
+			peaks = [ (round(own + rng.gauss(0.0, 0.25)), 600.0) ]
+			if bench.echo:
+				d, a = bench.echo
+				pos = own + d * self.rate + rng.gauss(0.0, 0.25)
+				if pos < self.max_delay * self.rate:
+					peaks.append((round(pos), 600.0 * a * a))
+			peaks.sort(key=lambda p: -p[1])
+			res.append(peaks)
+
+		return res
+
+	def stop(self):
+		pass
+
+
+class SimRfds:
+	"""Stand-in for osmo-rfds on the pluto"""
+
+	def __init__(self, args, bench):
+		self.args = args
+		self.bench = bench
+
+	def start(self, rate, delay, probe=False, mute=False):
+		bench = self.bench
+		latency = round(bench.rfds_latency_s * rate)
+		clock = 1.0 + bench.rfds_ppm * 1e-6
+
+		if not mute:
+			bench.echo = ((delay + latency) / (rate * clock), 0.5)
+
+		return float(latency) if probe else None
+
+	def stop(self):
+		self.bench.echo = None
+
+
+# ---------------------------------------------------------------------------
+# Measurement and fit
+# ---------------------------------------------------------------------------
+
+def median(v):
+	v = sorted(v)
+	n = len(v)
+	return v[n // 2] if n & 1 else 0.5 * (v[n // 2 - 1] + v[n // 2])
+
+
+def static_peaks(lines):
+	"""Peaks present with the echo muted (leak, reflections)"""
+	pos = {}
+	for peaks in lines:
+		for p, a in peaks:
+			pos[round(p)] = pos.get(round(p), 0) + 1
+	return [ p for p, c in pos.items() if c >= len(lines) // 2 ]
+
+
+def echo_position(lines, exclude, win=3):
+	"""Median position of the strongest peak that's not a static one"""
+	found = []
+	for peaks in lines:
+		for p, a in peaks:
+			if all(abs(p - e) > win for e in exclude):
+				found.append(p)
+				break
+	if len(found) < (len(lines) + 1) // 2:
+		return None
+	return median(found)
+
+
+def fit_line(x, y):
+	"""Least squares y = a + b * x, with rms and max residuals"""
+	n = len(x)
+	mx = sum(x) / n
+	my = sum(y) / n
+	sxx = sum((xi - mx) ** 2 for xi in x)
+	sxy = sum((xi - mx) * (yi - my) for xi, yi in zip(x, y))
+	b = sxy / sxx
+	a = my - b * mx
+	res = [ yi - (a + b * xi) for xi, yi in zip(x, y) ]
+	rms = math.sqrt(sum(r * r for r in res) / n)
+	return a, b, rms, max(abs(r) for r in res)
+
+
+def calibrate(args, pinger, rfds):
+	table = []
+
+	for rfds_rate in args.rfds_rates:
+		max_delay_s = max(args.delays) / rfds_rate + args.margin
+
+		# Pluto latency, measured by itself if TX is also coupled to RX
+		latency = None
+		if args.probe:
+			latency = rfds.start(rfds_rate, args.delays[0], probe=True)
+			rfds.stop()
+
+		if latency is None:
+			latency = args.rfds_latency
+			if latency is None:
+				log('[!] No pluto latency at %d sps, the pinger own latency can\'t be split out' % rfds_rate)
+			else:
+				log('[!] No latency probe result at %d sps, using %.1f samples' % (rfds_rate, latency))
+		else:
+			log('[+] osmo-rfds at %d sps : latency %.0f samples' % (rfds_rate, latency))
+
+		for rate in args.rates:
+			for mcr in args.mcrs:
+				rate, mcr = pinger.start(rate, mcr, max_delay_s)
+
+				try:
+					# Reference : echo muted
+					rfds.start(rfds_rate, args.delays[0], mute=True)
+					exclude = static_peaks(pinger.collect(args.count, args.discard))
+					rfds.stop()
+
+					x, y = [], []
+
+					for d in args.delays:
+						rfds.start(rfds_rate, d)
+						pos = echo_position(pinger.collect(args.count, args.discard), exclude)
+						rfds.stop()
+
+						# Programmed delay, in pinger samples
+						exp = d * rate / rfds_rate
+
+						if pos is None:
+							log('[!] %8.2f samples : echo not found' % d)
+							continue
+
+						log('[+] %8.2f samples : echo at %.1f (%.1f + %.2f)' % (d, pos, exp, pos - exp))
+						x.append(exp)
+						y.append(pos)
+
+				finally:
+					rfds.stop()
+					pinger.stop()
+
+				if len(x) < 3:
+					log('[!] Not enough points for %d sps / %d Hz MCR' % (rate, mcr))
+					continue
+
+				a, b, rms, mx = fit_line(x, y)
+
+				# The offset is the pinger own latency plus the pluto one
+				own = a - latency * rate / rfds_rate if latency is not None else float('nan')
+
+				log('[+] %d sps, %d Hz MCR, osmo-rfds %d sps : offset %.2f, gain %.6f, own latency %.2f, rms %.2f, max %.2f' %
+					(rate, mcr, rfds_rate, a, b, own, rms, mx))
+
+				table.append((rate, mcr, rfds_rate, a, b,
+					latency if latency is not None else float('nan'), own, rms, mx))
+
+	return table
+
+
+def write_table(fh, args, table):
+	fh.write('# osmo-rfds / uhd-pinger calibration table\n')
+	fh.write('# %s, %s, %d delays x %d measurements\n' % (
+		time.strftime('%Y-%m-%d %H:%M:%S'), 'simulated' if args.sim else 'measured',
+		len(args.delays), args.count))
+	fh.write('#\n')
+	fh.write('# Rates in Hz. offset (fitted, pinger samples), gain (measured /\n')
+	fh.write('# programmed delay), rfds_latency (pluto samples), pinger_latency\n')
+	fh.write('# (pinger own latency, pinger samples), rms / max (fit residuals)\n')
+	fh.write('#\n')
+	fh.write('# pinger_rate pinger_mcr rfds_rate offset gain rfds_latency pinger_latency rms max\n')
+	for e in table:
+		fh.write('%d %d %d %.3f %.7f %.1f %.3f %.3f %.3f\n' % e)
+
+
+# ---------------------------------------------------------------------------
+# Main
+# ---------------------------------------------------------------------------
+
+def num_list(conv):
+	return lambda s: [ conv(float(v)) for v in s.split(',') ]
+
+
+def main():
+	p = argparse.ArgumentParser(description='osmo-rfds / uhd-pinger latency calibration')
+
+	p.add_argument('--pinger', default='../uhd-pinger/pinger',
+		help='pinger command (default: %(default)s)')
+	p.add_argument('--pinger-args', default='',
+		help='extra pinger arguments (gains, ...)')
+	p.add_argument('--rfds', default='ssh -tt root@192.168.2.1 osmo-rfds',
+		help='osmo-rfds command (default: %(default)s)')
+	p.add_argument('--rfds-args', default='',
+		help='extra osmo-rfds arguments (gains, ...)')
+	p.add_argument('--sim', action='store_true',
+		help='use simulated stand-ins for the pinger and osmo-rfds')
+	p.add_argument('--seed', type=int, default=1,
+		help='simulation random seed')
+
+	p.add_argument('--freq-up', type=int, default=1000000000,
+		help='pinger TX / pluto RX frequency in Hz (default: %(default)s)')
+	p.add_argument('--freq-down', type=int, default=1100000000,
+		help='pluto TX / pinger RX frequency in Hz (default: %(default)s)')
+
+	p.add_argument('--rates', type=num_list(int), default=[2000000],
+		help='pinger sample rates, comma separated (default: 2000000)')
+	p.add_argument('--mcrs', type=num_list(int), default=[0],
+		help='pinger master clock rates, 0 for auto (default: 0)')
+	p.add_argument('--rfds-rates', type=num_list(int), default=[4000000],
+		help='osmo-rfds sample rates (default: 4000000)')
+	p.add_argument('--delays', type=num_list(float),
+		default=[100, 333.5, 1000, 2500.25, 5000, 10000, 20000],
+		help='osmo-rfds delays in samples (default: 100,333.5,...,20000)')
+	p.add_argument('--no-probe', dest='probe', action='store_false',
+		help='don\'t run the osmo-rfds latency probe (needs TX coupled to RX)')
+	p.add_argument('--rfds-latency', type=float, default=None,
+		help='pluto latency in samples, without or if the probe fails')
+
+	p.add_argument('--count', type=int, default=8,
+		help='measurements per point (default: %(default)s)')
+	p.add_argument('--discard', type=int, default=2,
+		help='pinger lines dropped after each change (default: %(default)s)')
+	p.add_argument('--settle', type=float, default=1.0,
+		help='wait after starting osmo-rfds, in s (default: %(default)s)')
+	p.add_argument('--period', type=float, default=0.25,
+		help='pinger burst period, in s (default: %(default)s)')
+	p.add_argument('--margin', type=float, default=500e-6,
+		help='pinger window past the longest delay, in s (default: %(default)s)')
+
+	p.add_argument('-o', '--output', default='rfds-calib.txt',
+		help='calibration table (default: %(default)s)')
+
+	args = p.parse_args()
+
+	if args.sim:
+		bench = SimBench(args.seed)
+		pinger, rfds = SimPinger(args, bench), SimRfds(args, bench)
+	else:
+		pinger, rfds = Pinger(args), Rfds(args)
+
+	try:
+		table = calibrate(args, pinger, rfds)
+	except (RuntimeError, OSError) as e:
+		log('[!] %s' % e)
+		return 1
+	except KeyboardInterrupt:
+		log('[!] Interrupted')
+		return 1
+
+	if not table:
+		log('[!] Nothing calibrated')
+		return 1
+
+	with open(args.output, 'w') as fh:
+		write_table(fh, args, table)
+
+	log('[+] Calibration table written to %s' % args.output)
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
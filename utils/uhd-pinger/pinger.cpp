@@ -9,9 +9,21 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
 #include <getopt.h>
+#include <signal.h>
+#include <sys/stat.h>
 
 #include <pthread.h>
+#include <semaphore.h>
+
+#include <atomic>
 
 #include <uhd/version.hpp>
 #include <uhd/device.hpp>
@@ -48,21 +60,102 @@ struct app_options {
 
 	int   burst_len;	/* # samples */
 	float burst_period;	/* s */
+	float min_delay;	/* s */
 	float max_delay;	/* s */
+
+	const char *otw;	/* RX over-the-wire format */
+
+	const char *record;	/* Raw capture files prefix, NULL if unused */
+
+	const char *calib;	/* Calibration table, NULL if unused */
+};
+
+/* Over-the-wire formats : bits per I or Q value */
+static const struct {
+	const char *name;
+	int bits;
+} otw_formats[] = {
+	{ "sc16", 16 },
+	{ "sc12", 12 },
+	{ "sc8",   8 },
+	{ NULL,    0 }
 };
 
+static int
+otw_bits(const char *name)
+{
+	for (int i=0; otw_formats[i].name; i++)
+		if (!strcmp(otw_formats[i].name, name))
+			return otw_formats[i].bits;
+	return 0;
+}
+
 struct app_burst {
 	int len;
 	struct osmo_cxvec *cxv;
 	int16_t *fxp;
 };
 
+/* Settings the TX and RX threads follow. The control interface builds a
+ * new one for each change and both threads switch to it on the same
+ * burst, from ts_start on. */
+struct app_sched {
+	unsigned int id;
+	struct app_options opts;
+
+	struct app_burst burst;
+
+	long long ts_start;	/* ticks, first burst using these settings */
+	long long ts_step;	/* ticks, burst period */
+	int rx_ofs;		/* # samples, RX window start after the TX burst */
+	int rx_len;		/* # samples, RX window length */
+
+	double t_cmd;		/* s, host time the change was requested */
+	long long ts_blank;	/* ticks, RX windows ending past it are dropped until ts_start */
+};
+
+/* Raw capture : the RX thread hands each window over to the writer thread
+ * through a ring of preallocated aligned buffers, without ever waiting.
+ * Buffers are sized for the initial window and grown by the RX thread when
+ * a change makes the window larger, while it owns them. */
+#define REC_N_BUFS	64
+#define REC_ALIGN	4096
+#define REC_REPORT	5.0	/* s */
+
+struct rec_window {
+	void *buf;
+	size_t size;		/* bytes, allocated */
+	size_t len;		/* bytes, padded to REC_ALIGN */
+	int n_samps;
+	long long ts_tx;	/* ticks */
+	long long ts_rx;	/* ticks, first sample received */
+};
+
+struct app_rec {
+	int fd_data;
+	FILE *fd_idx;
+	size_t buf_size;
+	off_t data_ofs;
+
+	struct rec_window win[REC_N_BUFS];
+	std::atomic<unsigned int> head;	/* Written by the RX thread */
+	std::atomic<unsigned int> tail;	/* Written by the writer thread */
+	std::atomic<int> stop;
+	sem_t sem;
+
+	pthread_t thread;
+
+	/* Stats */
+	unsigned long long windows;
+	unsigned long long bytes;
+	std::atomic<unsigned long long> dropped;
+};
+
 struct app_state {
 	/* Options */
 	struct app_options opts;
 
 	/* Burst data */
-	struct app_burst burst;
 	struct osmo_cxvec *rxd_cxv;
 	struct osmo_cxvec *rxc_cxv;
 
@@ -77,10 +170,20 @@ struct app_state {
 	double mcr;
 	double samp_rate;
 
+	/* Own TX to RX latency, from the calibration table */
+	int calibrated;
+	double latency;		/* # samples */
+
 	/* Timing */
 	long long ts;
-	long long ts_step;
-	long long ts_listen;
+	std::atomic<struct app_sched *> sched;		/* Latest settings */
+	std::atomic<struct app_sched *> tx_sched;	/* In use by the TX thread */
+	std::atomic<struct app_sched *> rx_sched;	/* In use by the RX thread */
+	std::atomic<long long> tx_ts_next;		/* Next TX burst not sent yet */
+	std::atomic<int> running;
+
+	/* Recorder */
+	struct app_rec *rec;
 };
 
 
@@ -110,17 +213,13 @@ static const float rrc_taps[] = {
 	-5.7944e-03f, 3.7391e-03f, 1.3706e-03f
 };
 
-static int16_t *
-burst_gen(struct app_state *app)
+static void
+burst_gen(struct app_burst *b, int len, int sps)
 {
 	uint32_t lfsr = 1;
 	struct osmo_cxvec *burst;
-	int len, sps;
 
 	/* Generate a burst of random data */
-	len = app->opts.burst_len;
-	sps = app->sps;
-
 	burst = osmo_cxvec_alloc(len * sps);
 	burst->len = len * sps;
 
@@ -132,7 +231,7 @@ burst_gen(struct app_state *app)
 			1.0fJ * (1 - 2 * lfsr_next(&lfsr, POLY));
 
 	/* If it's SPS > 1, filter it with RRC */
-	if (app->sps > 1)
+	if (sps > 1)
 	{
 		struct osmo_cxvec *pulse;
 
@@ -149,21 +248,19 @@ burst_gen(struct app_state *app)
 	}
 
 	/* Save */
-	app->burst.len = len;
-	app->burst.cxv = burst;
+	b->len = len;
+	b->cxv = burst;
 
 	osmo_cxvec_dbg_dump(burst, "/tmp/burst.cfile");
 
 	/* Generate fixed point version for fast TX */
-	app->burst.fxp = (int16_t*)malloc(sizeof(int16_t) * 2 * burst->len);
+	b->fxp = (int16_t*)malloc(sizeof(int16_t) * 2 * burst->len);
 
 	for (int i=0; i<burst->len; i++)
 	{
-		app->burst.fxp[2*i+0] = (int16_t)(4096.0f * crealf(burst->data[i]));
-		app->burst.fxp[2*i+1] = (int16_t)(4096.0f * cimagf(burst->data[i]));
+		b->fxp[2*i+0] = (int16_t)(4096.0f * crealf(burst->data[i]));
+		b->fxp[2*i+1] = (int16_t)(4096.0f * cimagf(burst->data[i]));
 	}
-
-	return NULL;
 }
 
 static float
@@ -226,13 +323,19 @@ peaks_scan(const struct osmo_cxvec *cv, int *peaks_idx, float *peaks_mag, int N,
 }
 
 static void
-burst_find(struct app_state *app, int16_t *buf, int buf_len)
+burst_find(struct app_state *app, struct app_sched *s, int16_t *buf, int buf_len)
 {
 	int   peaks_idx[10];
 	float peaks_mag[10];
 	float pwr;
 
-	/* Alloc buffer */
+	/* Alloc buffer, again if the window grew */
+	if ((app->rxd_cxv != NULL) && (app->rxd_cxv->max_len < buf_len)) {
+		osmo_cxvec_free(app->rxd_cxv);
+		osmo_cxvec_free(app->rxc_cxv);
+		app->rxd_cxv = NULL;
+	}
+
 	if (app->rxd_cxv == NULL) {
 		app->rxd_cxv = osmo_cxvec_alloc(buf_len);
 		app->rxc_cxv = osmo_cxvec_alloc(buf_len);
@@ -249,28 +352,427 @@ burst_find(struct app_state *app, int16_t *buf, int buf_len)
 	app->rxd_cxv->len = buf_len;
 
 	/* Correlate */
-	osmo_cxvec_correlate(app->burst.cxv, app->rxd_cxv, 1, app->rxc_cxv);
+	osmo_cxvec_correlate(s->burst.cxv, app->rxd_cxv, 1, app->rxc_cxv);
 
 	/* Peak finding */
 	pwr = peaks_scan(app->rxc_cxv, peaks_idx, peaks_mag, 10, 25);
 
 	/* Display results */
 	fprintf(stderr, "[+] Echo at : ");
-	for (int i=0; i<10; i++)
-		if ((peaks_mag[i] > (pwr * 25.0f)) &&
-		    (peaks_mag[i] > (peaks_mag[0] / 10.0f)) &&
-		    (peaks_idx[i] > 0))
-			fprintf(stderr, "%s%d (%f)", i ? ", " : "", peaks_idx[i], peaks_mag[i]);
-		else
+	for (int i=0; i<10; i++) {
+		if ((peaks_mag[i] <= (pwr * 25.0f)) ||
+		    (peaks_mag[i] <= (peaks_mag[0] / 10.0f)) ||
+		    ((s->rx_ofs + peaks_idx[i]) <= 0))
 			break;
+
+		/* Calibrated : relative to our own TX to RX latency */
+		if (app->calibrated)
+			fprintf(stderr, "%s%.1f (%f)", i ? ", " : "", s->rx_ofs + peaks_idx[i] - app->latency, peaks_mag[i]);
+		else
+			fprintf(stderr, "%s%d (%f)", i ? ", " : "", s->rx_ofs + peaks_idx[i], peaks_mag[i]);
+	}
 	fprintf(stderr, "\n");
 }
 
 static void
-burst_free(struct app_state *app)
+burst_otw_check(struct app_state *app, struct app_burst *burst)
 {
-	osmo_cxvec_free(app->burst.cxv);
-	free(app->burst.fxp);
+	struct osmo_cxvec *ref, *rxq, *cor;
+	int   peaks_idx[10];
+	float peaks_mag[10];
+	float lsb, sig_pwr, err_pwr, peak_ref;
+	int bits, len, ofs, idx_ref;
+
+	/* Measure the effect of the RX wire format resolution : a copy of the
+	 * burst at the TX level (-18 dBFS) is quantized like the samples going
+	 * through the wire would be and correlated like a received one */
+	bits = otw_bits(app->opts.otw);
+	lsb  = 1.0f / (float)(1 << (bits - 1));
+	len  = burst->cxv->len;
+	ofs  = len / 2;
+
+	ref = osmo_cxvec_alloc(2 * len);
+	rxq = osmo_cxvec_alloc(2 * len);
+	cor = osmo_cxvec_alloc(2 * len);
+
+	ref->len = rxq->len = 2 * len;
+	memset(ref->data, 0x00, sizeof(float complex) * 2 * len);
+	memset(rxq->data, 0x00, sizeof(float complex) * 2 * len);
+
+	sig_pwr = err_pwr = 0.0f;
+
+	for (int i=0; i<len; i++) {
+		float complex v = burst->cxv->data[i] * (4096.0f / 32768.0f);
+		float complex q =
+			(lsb * rintf(crealf(v) / lsb)) +
+			(lsb * rintf(cimagf(v) / lsb)) * 1.0fJ;
+
+		ref->data[ofs+i] = v;
+		rxq->data[ofs+i] = q;
+
+		sig_pwr += osmo_normsqf(v);
+		err_pwr += osmo_normsqf(q - v);
+	}
+
+	osmo_cxvec_correlate(burst->cxv, ref, 1, cor);
+	peaks_scan(cor, peaks_idx, peaks_mag, 10, 25);
+	idx_ref  = peaks_idx[0];
+	peak_ref = peaks_mag[0];
+
+	osmo_cxvec_correlate(burst->cxv, rxq, 1, cor);
+	peaks_scan(cor, peaks_idx, peaks_mag, 10, 25);
+
+	if (err_pwr > 0.0f)
+		fprintf(stderr, "[+] RX wire format %s : quantization SNR %.1f dB, %.1f dB after correlation, peak %+.2f dB at %+d samples\n",
+			app->opts.otw,
+			10.0f * log10f(sig_pwr / err_pwr),
+			10.0f * log10f(sig_pwr / err_pwr) + 10.0f * log10f((float)len),
+			10.0f * log10f(peaks_mag[0] / peak_ref),
+			peaks_idx[0] - idx_ref);
+	else
+		fprintf(stderr, "[+] RX wire format %s : no quantization loss\n", app->opts.otw);
+
+	osmo_cxvec_free(cor);
+	osmo_cxvec_free(rxq);
+	osmo_cxvec_free(ref);
+}
+
+static void
+burst_free(struct app_burst *burst)
+{
+	osmo_cxvec_free(burst->cxv);
+	free(burst->fxp);
+}
+
+
+static struct app_sched *
+sched_new(struct app_state *app, const struct app_options *opts)
+{
+	struct app_sched *s = new app_sched();
+
+	s->opts = *opts;
+
+	burst_gen(&s->burst, opts->burst_len, app->sps);
+
+	s->ts_step = (long long)(app->mcr * opts->burst_period);
+
+	/* Only receive the delay range of interest : the window covers echoes
+	 * starting from min to max delay, burst included, and the reported
+	 * positions are made absolute again */
+	s->rx_ofs = (int)(app->samp_rate * opts->min_delay);
+	s->rx_len = (int)(app->samp_rate * opts->max_delay) - s->rx_ofs + s->burst.cxv->len;
+
+	fprintf(stderr, "[+] RX window : %d samples from +%d (%.1f kB per burst)\n",
+		s->rx_len, s->rx_ofs, s->rx_len * 2 * otw_bits(opts->otw) / 8 / 1e3);
+
+	return s;
+}
+
+static void
+sched_free(struct app_sched *s)
+{
+	burst_free(&s->burst);
+	delete s;
+}
+
+
+static double
+host_time(void)
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return tp.tv_sec + tp.tv_nsec * 1e-9;
+}
+
+static void *
+rec_thread_fn(void *arg)
+{
+	struct app_state *app = (struct app_state *)arg;
+	struct app_rec *rec = app->rec;
+	double t_start, t_report;
+	unsigned long long bytes_report = 0, dropped_report = 0;
+
+	t_start = t_report = host_time();
+
+	while (1)
+	{
+		struct rec_window *w = NULL;
+		struct timespec tp;
+		unsigned long long dropped;
+		unsigned int tail;
+		ssize_t rv;
+		double t;
+
+		/* Wake up at least once per report, drops must be reported even
+		 * when no window gets through */
+		clock_gettime(CLOCK_REALTIME, &tp);
+		tp.tv_sec += (time_t)REC_REPORT;
+		sem_timedwait(&rec->sem, &tp);
+
+		if (rec->stop.load())
+			break;
+
+		tail = rec->tail.load(std::memory_order_relaxed);
+		if (tail != rec->head.load(std::memory_order_acquire))
+			w = &rec->win[tail % REC_N_BUFS];
+
+		if (!w)
+			goto report;
+
+		/* Data, then the index line pointing to it */
+		rv = pwrite(rec->fd_data, w->buf, w->len, rec->data_ofs);
+		if (rv != (ssize_t)w->len) {
+			fprintf(stderr, "[!] Recorder write failed : %s, stopping\n",
+				rv < 0 ? strerror(errno) : "short write");
+			break;
+		}
+
+		fprintf(rec->fd_idx, "%llu %lld %lld %lld %d\n",
+			rec->windows, w->ts_tx, w->ts_rx, (long long)rec->data_ofs, w->n_samps);
+
+		rec->data_ofs += w->len;
+		rec->windows++;
+		rec->bytes += w->n_samps * 2 * sizeof(int16_t);
+
+		rec->tail.store(tail + 1, std::memory_order_release);
+
+report:
+		/* Periodic report */
+		t = host_time();
+		if ((t - t_report) >= REC_REPORT) {
+			fflush(rec->fd_idx);
+			dropped = rec->dropped.load();
+			fprintf(stderr, "[%c] Recorder : %.2f MB/s (%.2f MB/s average), %llu windows, %llu dropped\n",
+				dropped != dropped_report ? '!' : '+',
+				(rec->bytes - bytes_report) / (t - t_report) / 1e6,
+				rec->bytes / (t - t_start) / 1e6,
+				rec->windows, dropped);
+			t_report = t;
+			bytes_report = rec->bytes;
+			dropped_report = dropped;
+		}
+	}
+
+	fflush(rec->fd_idx);
+
+	return NULL;
+}
+
+static int
+rec_open(struct app_state *app)
+{
+	struct app_rec *rec;
+	struct app_sched *s = app->sched.load();
+	std::string prefix = app->opts.record;
+	std::string data_name = prefix + ".sc16";
+	std::string idx_name  = prefix + ".idx";
+
+	rec = new app_rec();
+	rec->head = 0;
+	rec->tail = 0;
+	rec->stop = 0;
+	rec->dropped = 0;
+
+	/* Data file, bypassing the page cache if the filesystem allows it */
+	rec->fd_data = open(data_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	if ((rec->fd_data < 0) && (errno == EINVAL)) {
+		fprintf(stderr, "[!] O_DIRECT not supported for '%s', using buffered writes\n", data_name.c_str());
+		rec->fd_data = open(data_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (rec->fd_data < 0) {
+		fprintf(stderr, "[!] Failed to open '%s' : %s\n", data_name.c_str(), strerror(errno));
+		goto err;
+	}
+
+	/* Index, with the configuration needed to interpret the data */
+	rec->fd_idx = fopen(idx_name.c_str(), "w");
+	if (!rec->fd_idx) {
+		fprintf(stderr, "[!] Failed to open '%s' : %s\n", idx_name.c_str(), strerror(errno));
+		goto err;
+	}
+
+	fprintf(rec->fd_idx, "# pinger raw capture, %s\n", data_name.c_str());
+	fprintf(rec->fd_idx, "# format       : sc16 interleaved I/Q, little endian, windows padded to %d bytes\n", REC_ALIGN);
+	fprintf(rec->fd_idx, "# tx_freq      : %.0f\n", app->opts.tx_freq);
+	fprintf(rec->fd_idx, "# rx_freq      : %.0f\n", app->opts.rx_freq);
+	fprintf(rec->fd_idx, "# tx_gain      : %.1f\n", app->opts.tx_gain);
+	fprintf(rec->fd_idx, "# rx_gain      : %.1f\n", app->opts.rx_gain);
+	fprintf(rec->fd_idx, "# mcr          : %.0f\n", app->mcr);
+	fprintf(rec->fd_idx, "# samp_rate    : %.0f\n", app->samp_rate);
+	fprintf(rec->fd_idx, "# otw          : %s\n", app->opts.otw);
+	fprintf(rec->fd_idx, "# burst_len    : %d\n", s->burst.cxv->len);
+	fprintf(rec->fd_idx, "# burst_period : %lld\n", s->ts_step);
+	fprintf(rec->fd_idx, "# rx_ofs       : %d\n", s->rx_ofs);
+	fprintf(rec->fd_idx, "# window ts_tx ts_rx offset n_samps (timestamps in mcr ticks)\n");
+
+	/* Buffers, for the initial window size */
+	rec->buf_size = (s->rx_len * 2 * sizeof(int16_t) + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1);
+
+	for (int i=0; i<REC_N_BUFS; i++) {
+		if (posix_memalign(&rec->win[i].buf, REC_ALIGN, rec->buf_size)) {
+			fprintf(stderr, "[!] Failed to allocate recorder buffers\n");
+			goto err;
+		}
+		memset(rec->win[i].buf, 0x00, rec->buf_size);
+		rec->win[i].size = rec->buf_size;
+	}
+
+	sem_init(&rec->sem, 0, 0);
+
+	fprintf(stderr, "[+] Recording RX windows to '%s' (%.1f MB/s)\n",
+		data_name.c_str(), rec->buf_size / (s->ts_step / app->mcr) / 1e6);
+
+	app->rec = rec;
+
+	pthread_create(&rec->thread, NULL, rec_thread_fn, app);
+
+	return 0;
+
+err:
+	for (int i=0; i<REC_N_BUFS; i++)
+		free(rec->win[i].buf);
+	if (rec->fd_idx)
+		fclose(rec->fd_idx);
+	if (rec->fd_data >= 0)
+		close(rec->fd_data);
+	delete rec;
+	return -1;
+}
+
+static void
+rec_push(struct app_state *app, const int16_t *buf, int n_samps, long long ts_tx, long long ts_rx)
+{
+	struct app_rec *rec = app->rec;
+	unsigned int head = rec->head.load(std::memory_order_relaxed);
+	size_t len = (n_samps * 2 * sizeof(int16_t) + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1);
+	struct rec_window *w;
+	void *buf_new;
+
+	/* Never wait for the writer, drop the window if it's behind */
+	if ((head - rec->tail.load(std::memory_order_acquire)) >= REC_N_BUFS) {
+		rec->dropped++;
+		return;
+	}
+
+	w = &rec->win[head % REC_N_BUFS];
+
+	/* Window made larger by a change since, grow the buffer (not the
+	 * writer's until pushed), once per buffer */
+	if (len > w->size) {
+		if (posix_memalign(&buf_new, REC_ALIGN, len)) {
+			rec->dropped++;
+			return;
+		}
+		memset(buf_new, 0x00, len);
+		free(w->buf);
+		w->buf  = buf_new;
+		w->size = len;
+	}
+
+	memcpy(w->buf, buf, n_samps * 2 * sizeof(int16_t));
+	w->len     = len;
+	w->n_samps = n_samps;
+	w->ts_tx   = ts_tx;
+	w->ts_rx   = ts_rx;
+
+	rec->head.store(head + 1, std::memory_order_release);
+	sem_post(&rec->sem);
+}
+
+static void
+rec_close(struct app_state *app)
+{
+	struct app_rec *rec = app->rec;
+
+	if (!rec)
+		return;
+
+	/* Let the writer catch up, unless it stopped, then have it flush the
+	 * index and exit */
+	for (int i=0; (i<500) && (rec->tail.load() != rec->head.load()); i++)
+		usleep(10000);
+
+	rec->stop.store(1);
+	sem_post(&rec->sem);
+	pthread_join(rec->thread, NULL);
+
+	fprintf(stderr, "[%c] Recorder : %llu windows, %.1f MB written, %llu dropped, %u not written\n",
+		(rec->dropped.load() || (rec->head.load() != rec->tail.load())) ? '!' : '+',
+		rec->windows, rec->bytes / 1e6, rec->dropped.load(),
+		rec->head.load() - rec->tail.load());
+
+	fclose(rec->fd_idx);
+	close(rec->fd_data);
+	sem_destroy(&rec->sem);
+
+	for (int i=0; i<REC_N_BUFS; i++)
+		free(rec->win[i].buf);
+
+	delete rec;
+	app->rec = NULL;
+}
+
+
+/*
+ * Calibration table, as written by utils/rfds-calib : one line per
+ * measured setup, '#' comments,
+ *
+ *   pinger_rate pinger_mcr rfds_rate offset gain rfds_latency pinger_latency rms max
+ *
+ * The pinger only uses its own latency, for its sample rate and master
+ * clock rate, averaged over the entries for all the osmo-rfds rates.
+ */
+static int
+calib_load(struct app_state *app)
+{
+	const char *path = app->opts.calib;
+	double v[9], sum = 0.0;
+	char line[256];
+	int n = 0;
+	FILE *fh;
+
+	fh = fopen(path, "r");
+	if (!fh) {
+		fprintf(stderr, "[!] Failed to open calibration table '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fh))
+	{
+		if ((line[0] == '#') || (line[0] == '\n'))
+			continue;
+
+		if (sscanf(line, "%lf %lf %lf %lf %lf %lf %lf %lf %lf",
+			   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) != 9) {
+			fprintf(stderr, "[!] Invalid calibration table line : %s", line);
+			continue;
+		}
+
+		/* No own latency without the pluto one */
+		if (isnan(v[6]))
+			continue;
+
+		if ((fabs(v[0] - app->samp_rate) < 1.0) && (fabs(v[1] - app->mcr) < 1.0)) {
+			sum += v[6];
+			n++;
+		}
+	}
+
+	fclose(fh);
+
+	if (!n) {
+		fprintf(stderr, "[!] No calibration for %.0f sps with a %.0f Hz master clock in '%s'\n",
+			app->samp_rate, app->mcr, path);
+		return -1;
+	}
+
+	app->latency = sum / n;
+	app->calibrated = 1;
+
+	fprintf(stderr, "[+] Calibration : own latency %.2f samples (%.3f us), echo positions are corrected\n",
+		app->latency, app->latency / app->samp_rate * 1e6);
+
+	return 0;
 }
 
 
@@ -284,7 +786,6 @@ dev_open(struct app_state *app)
 		args += "master_clock_rate=" + std::to_string(app->opts.mcr);
 
 	uhd::device_addr_t addr(args);
-	uhd::device_addrs_t dev_addrs = uhd::device::find(addr);
 
 	app->usrp = uhd::usrp::multi_usrp::make(addr);
 
@@ -300,8 +801,9 @@ dev_open(struct app_state *app)
 	app->tx = app->usrp->get_tx_stream(tx_stream_args);
 	app->tx_spp = app->tx->get_max_num_samps();
 
-	/* RX setup */
-	uhd::stream_args_t rx_stream_args("sc16");
+	/* RX setup, the samples are converted back to sc16 on the host
+	 * whatever the wire format, so the rest doesn't need to care */
+	uhd::stream_args_t rx_stream_args("sc16", app->opts.otw);
 	rx_stream_args.args["recv_frame_size"] = addr.get("recv_frame_size", "4096");
 	rx_stream_args.args["num_recv_frames"] = addr.get("num_recv_frames", "1024");
 
@@ -380,50 +882,98 @@ static void *
 rx_thread_fn(void *arg)
 {
 	struct app_state *app = (struct app_state *)arg;
+	struct app_sched *s, *s_prev, *n;
 	long long ts = app->ts;
 
-	int bl;
+	int bl, bl_prev, bl_max;
 	int16_t *buf;
-	std::vector<int16_t *> buff_ptrs;
+	long long ts_rx;
+	bool announce = false;
+	bool blank;
 
 	/* Buffer */
-	bl = app->ts_listen;
-	buf = (int16_t*) malloc(sizeof(int16_t) * 2 * bl);
-	buff_ptrs.push_back(buf);
+	s = s_prev = app->sched.load();
+	bl_prev = 0;
+	bl_max = s->rx_len;
+	buf = (int16_t*) malloc(sizeof(int16_t) * 2 * bl_max);
 
-	/* Infinite loop */
-	while (1)
+	/* Loop until stopped */
+	while (app->running.load())
 	{
+		/* Switch settings on the burst they were scheduled for */
+		n = app->sched.load();
+		if ((n != s) && (ts >= n->ts_start)) {
+			s = n;
+			announce = true;
+		}
+
+		bl = s->rx_len;
+
 		/* Start streaming */
 		uhd::stream_cmd_t stream_cmd(uhd::stream_cmd_t::STREAM_MODE_NUM_SAMPS_AND_DONE);
 		stream_cmd.num_samps = bl;
 		stream_cmd.stream_now = false;
-		stream_cmd.time_spec = uhd::time_spec_t::from_ticks(ts, app->mcr);
+		stream_cmd.time_spec = uhd::time_spec_t::from_ticks(ts, app->mcr) +
+			uhd::time_spec_t((double)s->rx_ofs / app->samp_rate);
 		app->rx->issue_stream_cmd(stream_cmd);
 
-		/* Process buffer */
-		burst_find(app, buf, bl);
+		/* Process the previous buffer, with the settings it was received with */
+		if (bl_prev)
+			burst_find(app, s_prev, buf, bl_prev);
+
+		app->rx_sched.store(s);
+
+		if (bl > bl_max) {
+			bl_max = bl;
+			buf = (int16_t*) realloc(buf, sizeof(int16_t) * 2 * bl_max);
+		}
 
 		/* Receive loop */
+		ts_rx = -1;
+
 		for (int ofs=0; ofs<bl; )
 		{
 			std::vector<int16_t *> buff_ptrs;
 			uhd::rx_metadata_t md;
 
-			buff_ptrs.push_back(&buf[ofs]);
+			buff_ptrs.push_back(&buf[2*ofs]);
 
 			size_t num_rx_samps = app->rx->recv(
-				buff_ptrs, bl-ofs, md, app->opts.burst_period * 2.0f, false
+				buff_ptrs, bl-ofs, md, s->opts.burst_period * 2.0f, false
 			);
+			if ((ofs == 0) && (num_rx_samps > 0) && md.has_time_spec)
+				ts_rx = md.time_spec.to_ticks(app->mcr);
 			ofs += num_rx_samps;
 			if (num_rx_samps == 0)
 				printf("RX stall\n");
 		}
 
+		/* Windows possibly overlapping a pending retune, the device may
+		 * not have waited for the command time */
+		n = app->sched.load();
+		blank = (n != s) &&
+			((ts + (long long)((s->rx_ofs + bl) / app->samp_rate * app->mcr)) >= n->ts_blank);
+
+		/* Switch-over time, up to the first window received with the
+		 * new settings */
+		if (announce) {
+			fprintf(stderr, "[+] Change #%u : first window received %.1f ms after the command\n",
+				s->id, 1e3 * (host_time() - s->t_cmd));
+			announce = false;
+		}
+
+		/* Hand a copy over to the recorder */
+		if (app->rec && !blank)
+			rec_push(app, buf, bl, ts, ts_rx);
+
 		/* Next expected */
-		ts += app->ts_step;
+		s_prev = s;
+		bl_prev = blank ? 0 : bl;
+		ts += s->ts_step;
 	}
 
+	free(buf);
+
 	return NULL;
 }
 
@@ -431,10 +981,13 @@ static void *
 tx_thread_fn(void *arg)
 {
 	struct app_state *app = (struct app_state *)arg;
+	struct app_sched *s, *n;
 	long long ts = app->ts;
 	int pending = 0;
 
-	while (1)
+	s = app->sched.load();
+
+	while (app->running.load())
 	{
 		uhd::tx_metadata_t md;
 		int rv, bl;
@@ -442,19 +995,27 @@ tx_thread_fn(void *arg)
 		/* Send burst if no too many are pending */
 		if (pending < 2)
 		{
+			/* Switch settings on the burst they were scheduled for */
+			n = app->sched.load();
+			if ((n != s) && (ts >= n->ts_start)) {
+				s = n;
+				app->tx_sched.store(s);
+			}
+
 			/* Try to send burst */
 			md.has_time_spec  = true;
 			md.start_of_burst = true;
 			md.end_of_burst   = true;
 			md.time_spec      = uhd::time_spec_t::from_ticks(ts, app->mcr);
 
-			bl = app->burst.len;
+			bl = s->burst.cxv->len;
 
-			rv = app->tx->send(app->burst.fxp, bl, md, 0.1f);
+			rv = app->tx->send(s->burst.fxp, bl, md, 0.1f);
 			if (rv != bl)
 				fprintf(stderr, "[!] TX rv: %d\n", rv);
 
-			ts += app->ts_step;
+			ts += s->ts_step;
+			app->tx_ts_next.store(ts);
 			pending++;
 		}
 
@@ -473,6 +1034,212 @@ tx_thread_fn(void *arg)
 }
 
 
+/* ------------------------------------------------------------------------ */
+/* Live control                                                             */
+/* ------------------------------------------------------------------------ */
+
+/*
+ * Commands are read from stdin, one change per line, as "key value" pairs
+ * which are all applied together on the same burst :
+ *
+ *   tx-freq 1.8e9 rx-freq 1.8e9
+ *   burst-period 0.1 max-delay 20e-3
+ *
+ * The change is scheduled on the first burst boundary far enough ahead
+ * for both threads (and the device command queue) to get it in time.
+ * Frequency and gain changes are sent as timed commands, for the gap
+ * between the last RX window with the old settings and the first burst
+ * with the new ones. Not all devices honor those : the AD936x based ones
+ * retune over SPI right away. So the RX windows from the time the
+ * commands are sent up to the new settings are dropped, and no window
+ * reported or recorded ever straddles a retune.
+ */
+
+#define CTL_LEAD	100e-3		/* s, minimum notice for a change */
+
+static void
+ctl_help(void)
+{
+	fprintf(stderr, "[+] Commands : one change per line, made of 'key value' pairs\n");
+	fprintf(stderr, "  tx-freq <Hz>       rx-freq <Hz>       tx-gain <dB>     rx-gain <dB>\n");
+	fprintf(stderr, "  burst-len <n>      burst-period <s>   min-delay <s>    max-delay <s>\n");
+	fprintf(stderr, "  help               quit\n");
+}
+
+static int opts_check(struct app_options *opts);
+static int
+ctl_parse(struct app_options *opts, char *line)
+{
+	char *key, *val, *end, *save = NULL;
+	double v;
+
+	while ((key = strtok_r(save ? NULL : line, " \t\r\n", &save)) != NULL)
+	{
+		val = strtok_r(NULL, " \t\r\n", &save);
+		if (!val) {
+			fprintf(stderr, "[!] Missing value for '%s'\n", key);
+			return -1;
+		}
+
+		v = strtod(val, &end);
+		if (*end) {
+			fprintf(stderr, "[!] Invalid value '%s' for '%s'\n", val, key);
+			return -1;
+		}
+
+		if (!strcmp(key, "tx-freq"))
+			opts->tx_freq = v;
+		else if (!strcmp(key, "rx-freq"))
+			opts->rx_freq = v;
+		else if (!strcmp(key, "tx-gain"))
+			opts->tx_gain = v;
+		else if (!strcmp(key, "rx-gain"))
+			opts->rx_gain = v;
+		else if (!strcmp(key, "burst-len"))
+			opts->burst_len = (int)v;
+		else if (!strcmp(key, "burst-period"))
+			opts->burst_period = v;
+		else if (!strcmp(key, "min-delay"))
+			opts->min_delay = v;
+		else if (!strcmp(key, "max-delay"))
+			opts->max_delay = v;
+		else {
+			fprintf(stderr, "[!] Unknown setting '%s'\n", key);
+			return -1;
+		}
+	}
+
+	return opts_check(opts);
+}
+
+static void
+ctl_apply(struct app_state *app, const struct app_options *opts, double t_cmd)
+{
+	struct app_sched *cur = app->sched.load();
+	struct app_sched *n;
+	long long now, ts, lead, ts_tune;
+	double t0, t1;
+	int k;
+
+	n = sched_new(app, opts);
+	n->id = cur->id + 1;
+	n->t_cmd = t_cmd;
+
+	/* Schedule on a burst boundary of the current settings, past the
+	 * ones the TX thread already queued, and hand over to the threads */
+	now  = app->usrp->get_time_now().to_ticks(app->mcr);
+	lead = (long long)(CTL_LEAD * app->mcr);
+
+	ts = app->tx_ts_next.load() + cur->ts_step;
+	for (k=1; ts < (now + lead); k++)
+		ts += cur->ts_step;
+
+	n->ts_start = ts;
+	n->ts_blank = LLONG_MAX;
+
+	if ((opts->tx_freq != cur->opts.tx_freq) || (opts->rx_freq != cur->opts.rx_freq) ||
+	    (opts->tx_gain != cur->opts.tx_gain) || (opts->rx_gain != cur->opts.rx_gain))
+		n->ts_blank = now;
+
+	app->sched.store(n);
+
+	/* Retune, timed when supported, halfway between the end of the last window with the
+	 * current settings and the first burst with the new ones */
+	ts_tune = ts - (cur->ts_step - (long long)((cur->rx_ofs + cur->rx_len) / app->samp_rate * app->mcr)) / 2;
+
+	t0 = host_time();
+
+	app->usrp->set_command_time(uhd::time_spec_t::from_ticks(ts_tune, app->mcr));
+
+	if (opts->tx_freq != cur->opts.tx_freq)
+		app->usrp->set_tx_freq(opts->tx_freq);
+	if (opts->rx_freq != cur->opts.rx_freq)
+		app->usrp->set_rx_freq(opts->rx_freq);
+	if (opts->tx_gain != cur->opts.tx_gain)
+		app->usrp->set_tx_gain(opts->tx_gain);
+	if (opts->rx_gain != cur->opts.rx_gain)
+		app->usrp->set_rx_gain(opts->rx_gain);
+
+	app->usrp->clear_command_time();
+
+	t1 = host_time();
+
+	if (t1 - t0 > CTL_LEAD)
+		fprintf(stderr, "[!] Change #%u : device commands took %.1f ms, may be late\n",
+			n->id, 1e3 * (t1 - t0));
+
+	fprintf(stderr, "[+] Change #%u : scheduled %d bursts ahead, %.1f ms from now (commands took %.1f ms)\n",
+		n->id, k, 1e3 * (ts - now) / app->mcr, 1e3 * (t1 - t0));
+}
+
+static bool
+ctl_usable(void)
+{
+	struct stat st;
+
+	/* Terminal we're in the foreground of */
+	if (isatty(STDIN_FILENO))
+		return tcgetpgrp(STDIN_FILENO) == getpgrp();
+
+	/* Pipe or socket from a script */
+	if (fstat(STDIN_FILENO, &st))
+		return false;
+
+	return S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode);
+}
+
+static void *
+ctl_thread_fn(void *arg)
+{
+	struct app_state *app = (struct app_state *)arg;
+	struct app_sched *old = NULL;
+	char line[256];
+
+	ctl_help();
+
+	while (fgets(line, sizeof(line), stdin))
+	{
+		struct app_sched *cur = app->sched.load();
+		struct app_options opts = cur->opts;
+		double t_cmd = host_time();
+
+		/* Nothing to change */
+		if (line[strspn(line, " \t\r\n")] == '\0')
+			continue;
+
+		if (!strncmp(line, "quit", 4)) {
+			app->running.store(0);
+			break;
+		}
+
+		if (!strncmp(line, "help", 4)) {
+			ctl_help();
+			continue;
+		}
+
+		/* One change at a time, both threads must have taken the last one */
+		if ((app->tx_sched.load() != cur) || (app->rx_sched.load() != cur)) {
+			fprintf(stderr, "[!] Change #%u still pending, retry\n", cur->id);
+			continue;
+		}
+
+		/* Nobody uses the settings before the current ones anymore */
+		if (old && (old != cur)) {
+			sched_free(old);
+			old = NULL;
+		}
+
+		if (ctl_parse(&opts, line))
+			continue;
+
+		old = cur;
+		ctl_apply(app, &opts, t_cmd);
+	}
+
+	return NULL;
+}
+
+
 static void
 opts_defaults(struct app_options *opts)
 {
@@ -486,7 +1253,14 @@ opts_defaults(struct app_options *opts)
 
 	opts->burst_len = 256;		/* 128 us */
 	opts->burst_period = 250e-3;	/* 250 ms */
+	opts->min_delay = 0.0f;		/*   0 ms */
 	opts->max_delay = 5e-3;		/*   5 ms */
+
+	opts->otw = "sc16";
+
+	opts->record = NULL;
+
+	opts->calib = NULL;
 }
 
 static void
@@ -502,10 +1276,35 @@ opts_help(const char *argv0)
 	fprintf(stderr, " -s, --samplerate   \n");
 	fprintf(stderr, " -l, --burst-len    \n");
 	fprintf(stderr, " -p, --burst-period \n");
-	fprintf(stderr, " -m, --max-delay    \n");
+	fprintf(stderr, " -i, --min-delay    \n");
+	fprintf(stderr, " -d, --max-delay    \n");
+	fprintf(stderr, " -o, --otw          \n");
+	fprintf(stderr, " -w, --record       \n");
+	fprintf(stderr, " -c, --calib        \n");
 	fprintf(stderr, " -h, --help         \n");
 }
 
+static int
+opts_check(struct app_options *opts)
+{
+	if (opts->burst_len <= 0) {
+		fprintf(stderr, "[!] Burst length must be positive\n");
+		return -1;
+	}
+
+	if ((opts->min_delay < 0.0f) || (opts->max_delay <= opts->min_delay)) {
+		fprintf(stderr, "[!] Delays must verify 0 <= min-delay < max-delay\n");
+		return -1;
+	}
+
+	if (opts->max_delay >= opts->burst_period) {
+		fprintf(stderr, "[!] Maximum delay must be shorter than the burst period\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 static int
 opts_parse(struct app_options *opts, int argc, char *argv[])
 {
@@ -519,11 +1318,15 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 		{ "samplerate",   required_argument, 0, 's' },
 		{ "burst-len",    required_argument, 0, 'l' },
 		{ "burst-period", required_argument, 0, 'p' },
+		{ "min-delay",    required_argument, 0, 'i' },
 		{ "max-delay",    required_argument, 0, 'd' },
+		{ "otw",          required_argument, 0, 'o' },
+		{ "record",       required_argument, 0, 'w' },
+		{ "calib",        required_argument, 0, 'c' },
 		{ "help",       no_argument,       0, 'h' },
 		{0, 0, 0, 0}
 	};
-	const char *short_options = "t:r:T:R:m:s:l:p:d:h";
+	const char *short_options = "t:r:T:R:m:s:l:p:i:d:o:w:c:h";
 
 	while (1) {
 		int optidx;
@@ -565,10 +1368,30 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 			opts->burst_period = strtof(optarg, NULL);
 			break;
 
+		case 'i':
+			opts->min_delay = strtof(optarg, NULL);
+			break;
+
 		case 'd':
 			opts->max_delay = strtof(optarg, NULL);
 			break;
 
+		case 'o':
+			if (!otw_bits(optarg)) {
+				fprintf(stderr, "[!] Invalid wire format '%s' (sc16, sc12 or sc8)\n", optarg);
+				return -1;
+			}
+			opts->otw = optarg;
+			break;
+
+		case 'w':
+			opts->record = optarg;
+			break;
+
+		case 'c':
+			opts->calib = optarg;
+			break;
+
 		case 'h':
 			opts_help(argv[0]);
 			return 1;
@@ -579,7 +1402,7 @@ opts_parse(struct app_options *opts, int argc, char *argv[])
 		};
 	}
 
-	return 0;
+	return opts_check(opts);
 }
 
 static void
@@ -598,19 +1421,46 @@ opts_print(struct app_options *opts, FILE *fd)
 	else
 		fprintf(fd, "  . Master Clock Rate : Auto\n");
 	fprintf(fd, "  . Sample Rate       : %.3lf Msps\n", opts->samp_rate / 1e6);
+	fprintf(fd, "  . RX wire format    : %s (%.1f MB/s while receiving)\n",
+		opts->otw, opts->samp_rate * 2 * otw_bits(opts->otw) / 8 / 1e6);
 	fprintf(fd, "\n");
 
 	fprintf(fd, "  . Burst length      : %d samples\n", opts->burst_len);
 	fprintf(fd, "  . Burst period      : %.3f ms\n", 1e3f * opts->burst_period);
+	if (opts->min_delay > 0.0f)
+		fprintf(fd, "  . Minimum delay     : %.3f ms\n", 1e3f * opts->min_delay);
 	fprintf(fd, "  . Maximum delay     : %.3f ms\n", 1e3f * opts->max_delay);
 	fprintf(fd, "\n");
+
+	if (opts->record) {
+		fprintf(fd, "  . Record to         : %s.sc16 / %s.idx\n", opts->record, opts->record);
+		fprintf(fd, "\n");
+	}
+
+	if (opts->calib) {
+		fprintf(fd, "  . Calibration       : %s\n", opts->calib);
+		fprintf(fd, "\n");
+	}
+}
+
+
+/* Ctrl-C / kill : stop like 'quit' does, so the recorder gets closed and its
+ * index flushed. A second one kills right away. */
+static struct app_state *g_app;
+
+static void
+sig_handler(int signo)
+{
+	g_app->running.store(0);
 }
 
 
 int main(int argc, char *argv[])
 {
 	struct app_state _app, *app = &_app;
-	pthread_t tx_thread, rx_thread;
+	pthread_t tx_thread, rx_thread, ctl_thread;
+	struct sigaction sa;
+	bool ctl;
 	int rv;
 
 	/* Options */
@@ -632,28 +1482,68 @@ int main(int argc, char *argv[])
 	if (rv)
 		return -1;
 
-	/* Generate burst */
-	burst_gen(app);
+	fprintf(stderr, "[+] Device rates : %.0f sps, %.0f Hz master clock\n",
+		app->samp_rate, app->mcr);
+
+	/* Own latency for the actual rates */
+	if (app->opts.calib && calib_load(app))
+		return -1;
+
+	/* Initial settings and burst */
+	struct app_sched *sched = sched_new(app, &app->opts);
+	burst_otw_check(app, &sched->burst);
 
 	/* Get initial time */
 	uhd::time_spec_t now = app->usrp->get_time_now();
-	app->ts_step   = (long long)(app->mcr * app->opts.burst_period);
-	app->ts_listen = (long long)(app->mcr * app->opts.max_delay);
 	app->ts = now.to_ticks(app->mcr);
-	app->ts += app->ts_step;
+	app->ts += sched->ts_step;
+
+	sched->ts_start = app->ts;
+
+	app->sched.store(sched);
+	app->tx_sched.store(sched);
+	app->rx_sched.store(sched);
+	app->tx_ts_next.store(app->ts);
+	app->running.store(1);
+
+	/* Recorder */
+	if (app->opts.record && rec_open(app))
+		return -1;
+
+	/* Clean stop on signals */
+	g_app = app;
+
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler = sig_handler;
+	sa.sa_flags = SA_RESETHAND;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 
 	/* Start threads */
 	pthread_create(&tx_thread, NULL, tx_thread_fn, app);
 	pthread_create(&rx_thread, NULL, rx_thread_fn, app);
 
-	/* Wait for completion */
+	/* Control interface, only when stdin is something to type or pipe
+	 * commands into, a backgrounded pinger would get stopped reading it */
+	ctl = ctl_usable();
+	if (ctl)
+		pthread_create(&ctl_thread, NULL, ctl_thread_fn, app);
+
+	/* Wait for completion ('quit' on the control interface, or a signal) */
         pthread_join(tx_thread, NULL);
 
         pthread_cancel(rx_thread);
         pthread_join(rx_thread, NULL);
 
+	if (ctl) {
+		pthread_cancel(ctl_thread);
+		pthread_join(ctl_thread, NULL);
+	}
+
 	/* Cleanup */
-	burst_free(app);
+	rec_close(app);
+	sched_free(app->sched.load());
 
 	return 0;
 }